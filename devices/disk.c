@@ -32,6 +32,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +48,7 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_FLUSH_CACHE 0xe7            /* FLUSH CACHE. */
 
 /* An ATA device. */
 struct disk {
@@ -84,7 +86,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -209,6 +211,30 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
+	disk_read_sectors (d, sec_no, 1, buffer);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+	disk_write_sectors (d, sec_no, 1, buffer);
+}
+
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes and must not be user memory that could fault.  Issues
+   one command per DISK_MAX_TRANSFER sectors instead of one per
+   sector.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_sectors (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer_) {
+	uint8_t *buffer = buffer_;
 	struct channel *c;
 
 	ASSERT (d != NULL);
@@ -216,23 +242,39 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
+	while (cnt > 0) {
+		size_t n = cnt < DISK_MAX_TRANSFER ? cnt : DISK_MAX_TRANSFER;
+
+		/* The device interrupts once per sector it has ready. */
+		select_sector (d, sec_no, n);
+		issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+		for (size_t i = 0; i < n; i++) {
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu,
+						d->name, (disk_sector_t) (sec_no + i));
+			input_sector (c, buffer);
+			buffer += DISK_SECTOR_SIZE;
+		}
+		d->read_cnt += n;
+		sec_no += n;
+		cnt -= n;
+	}
 	lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   DISK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D
+   from BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes
+   and must not be user memory that could fault.  Issues one
+   command per DISK_MAX_TRANSFER sectors instead of one per
+   sector, and returns after the disk has acknowledged receiving
+   all of them.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 void
-disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+disk_write_sectors (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		const void *buffer_) {
+	const uint8_t *buffer = buffer_;
 	struct channel *c;
 
 	ASSERT (d != NULL);
@@ -240,16 +282,50 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	while (cnt > 0) {
+		size_t n = cnt < DISK_MAX_TRANSFER ? cnt : DISK_MAX_TRANSFER;
+
+		/* The device asks for each sector in turn and interrupts
+		   once it has taken it. */
+		select_sector (d, sec_no, n);
+		issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+		for (size_t i = 0; i < n; i++) {
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu,
+						d->name, (disk_sector_t) (sec_no + i));
+			output_sector (c, buffer);
+			buffer += DISK_SECTOR_SIZE;
+			sema_down (&c->completion_wait);
+		}
+		d->write_cnt += n;
+		sec_no += n;
+		cnt -= n;
+	}
 	lock_release (&c->lock);
 }
 
+/* Has disk D write back its volatile write cache, so that every
+   sector written to it so far survives a power failure.  Returns
+   after the disk reports that it has.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_flush (struct disk *d) {
+	struct channel *c;
+
+	ASSERT (d != NULL);
+
+	c = d->channel;
+	lock_acquire (&c->lock);
+	select_device_wait (d);
+	issue_pio_command (c, CMD_FLUSH_CACHE);
+	sema_down (&c->completion_wait);
+	wait_while_busy (d);
+	if (inb (reg_status (c)) & STA_ERR)
+		PANIC ("%s: disk cache flush failed", d->name);
+	lock_release (&c->lock);
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -402,17 +478,20 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the CNT sectors to transfer from there to
+   the disk's sector selection registers.  (We use LBA mode.)
+   A sector count register of 0 means DISK_MAX_TRANSFER. */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
+	ASSERT (cnt >= 1 && cnt <= DISK_MAX_TRANSFER);
 	ASSERT (sec_no < d->capacity);
+	ASSERT (cnt <= d->capacity - sec_no);
 	ASSERT (sec_no < (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt == DISK_MAX_TRANSFER ? 0 : cnt);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
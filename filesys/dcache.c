@@ -0,0 +1,177 @@
+/* dcache.c: Dentry cache.
+ *
+ * Caches the result of looking a name up in a directory, keyed on
+ * the directory's inode sector and the name, so that resolving a
+ * name again reads no directory blocks.  Names found not to exist
+ * are cached too, as negative entries.  The cache holds at most
+ * DCACHE_MAX entries and drops the least recently used one when
+ * full. */
+
+#include "filesys/dcache.h"
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Most entries cached. */
+#define DCACHE_MAX 256
+
+/* A cached name. */
+struct dentry {
+	struct hash_elem elem;              /* Element in dentries. */
+	struct list_elem lru_elem;          /* Element in lru. */
+	disk_sector_t dir;                  /* Sector of directory inode. */
+	char name[NAME_MAX + 1];            /* Null terminated file name. */
+	bool exists;                        /* False: negative entry. */
+	disk_sector_t sector;               /* Inode sector, if EXISTS. */
+};
+
+/* DCACHE_LOCK guards DENTRIES, LRU (most recent first), and
+ * GENERATION.  GENERATION counts invalidations, so that a lookup that
+ * missed and then read the directory does not cache what it read if
+ * the directory changed meanwhile. */
+static struct hash dentries;
+static struct list lru;
+static struct lock dcache_lock;
+static unsigned generation;
+
+/* Returns a hash value for dentry D. */
+static uint64_t
+dentry_hash (const struct hash_elem *d_, void *aux UNUSED) {
+	const struct dentry *d = hash_entry (d_, struct dentry, elem);
+	return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+/* Returns true if dentry A precedes dentry B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dentry *a = hash_entry (a_, struct dentry, elem);
+	const struct dentry *b = hash_entry (b_, struct dentry, elem);
+	if (a->dir != b->dir)
+		return a->dir < b->dir;
+	return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the dentry cache. */
+void
+dcache_init (void) {
+	hash_init (&dentries, dentry_hash, dentry_less, NULL);
+	list_init (&lru);
+	lock_init (&dcache_lock);
+	generation = 0;
+}
+
+/* Returns the entry for NAME in DIR, or a null pointer.
+ * DCACHE_LOCK must be held. */
+static struct dentry *
+dentry_find (disk_sector_t dir, const char *name) {
+	struct dentry key;
+	struct hash_elem *e;
+
+	key.dir = dir;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dentries, &key.elem);
+	return e != NULL ? hash_entry (e, struct dentry, elem) : NULL;
+}
+
+/* Drops dentry D.  DCACHE_LOCK must be held. */
+static void
+dentry_free (struct dentry *d) {
+	hash_delete (&dentries, &d->elem);
+	list_remove (&d->lru_elem);
+	free (d);
+}
+
+/* Looks NAME up in directory DIR.  On a hit, returns DCACHE_FOUND and
+ * stores the inode sector in *SECTORP, or returns DCACHE_ABSENT.  On
+ * a miss, returns DCACHE_MISS and stores in *GENP the value to pass
+ * to dcache_insert() once the directory has been read. */
+enum dcache_result
+dcache_lookup (disk_sector_t dir, const char *name, disk_sector_t *sectorp,
+		unsigned *genp) {
+	enum dcache_result result = DCACHE_MISS;
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return DCACHE_MISS;
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (dir, name);
+	if (d != NULL) {
+		list_remove (&d->lru_elem);
+		list_push_front (&lru, &d->lru_elem);
+		if (d->exists) {
+			*sectorp = d->sector;
+			result = DCACHE_FOUND;
+		} else
+			result = DCACHE_ABSENT;
+	}
+	*genp = generation;
+	lock_release (&dcache_lock);
+	return result;
+}
+
+/* Caches that NAME in DIR is at inode SECTOR if EXISTS is true, or
+ * does not exist otherwise.  Does nothing if the cache was
+ * invalidated since the dcache_lookup() that returned GEN. */
+void
+dcache_insert (disk_sector_t dir, const char *name, bool exists,
+		disk_sector_t sector, unsigned gen) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+	d = malloc (sizeof *d);
+	if (d == NULL)
+		return;
+	d->dir = dir;
+	strlcpy (d->name, name, sizeof d->name);
+	d->exists = exists;
+	d->sector = sector;
+
+	lock_acquire (&dcache_lock);
+	if (gen != generation || hash_insert (&dentries, &d->elem) != NULL) {
+		lock_release (&dcache_lock);
+		free (d);
+		return;
+	}
+	list_push_front (&lru, &d->lru_elem);
+	if (hash_size (&dentries) > DCACHE_MAX)
+		dentry_free (list_entry (list_back (&lru), struct dentry, lru_elem));
+	lock_release (&dcache_lock);
+}
+
+/* Forgets what is cached for NAME in DIR.  Called whenever NAME is
+ * added to or removed from DIR. */
+void
+dcache_invalidate (disk_sector_t dir, const char *name) {
+	struct dentry *d;
+
+	lock_acquire (&dcache_lock);
+	generation++;
+	d = dentry_find (dir, name);
+	if (d != NULL)
+		dentry_free (d);
+	lock_release (&dcache_lock);
+}
+
+/* Forgets everything cached for names in DIR.  Called by
+ * dir_create() when sector DIR is made into a new directory, since it
+ * may have held an older one whose names are still cached. */
+void
+dcache_purge_dir (disk_sector_t dir) {
+	struct list_elem *e, *next;
+
+	lock_acquire (&dcache_lock);
+	generation++;
+	for (e = list_begin (&lru); e != list_end (&lru); e = next) {
+		struct dentry *d = list_entry (e, struct dentry, lru_elem);
+		next = list_next (e);
+		if (d->dir == dir)
+			dentry_free (d);
+	}
+	lock_release (&dcache_lock);
+}
@@ -1,9 +1,13 @@
 #include "filesys/directory.h"
+#include <hash.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 
 /* A directory. */
@@ -19,10 +23,299 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* Directory formats.
+ *
+ * A small directory is a flat array of entries, searched linearly.
+ * Once adding to it would take more than DIR_LINEAR_MAX entries, it
+ * is rewritten as a hash index: the first sector holds a header,
+ * and each following sector is a bucket of BUCKET_ENTRIES entries.
+ * A name lives in bucket hash_string (name) mod the bucket count, a
+ * power of 2.  When a name's bucket is full, every bucket is split
+ * in two, doubling the count.  Lookup and remove read one bucket;
+ * an insert reads one, except when it splits.  An entry counts only in
+ * the bucket its name belongs in: a split leaves copies of the entries
+ * it moves behind, which are free slots from then on.
+ *
+ * The header is the first entry of the directory.  It is a free
+ * entry, so readers of the flat format pass over it, whose
+ * inode_sector is DIR_INDEX_MAGIC and whose name holds the bucket
+ * count. */
+#define DIR_LINEAR_MAX 50
+#define DIR_INDEX_MAGIC ((disk_sector_t) -1)
+#define BUCKET_ENTRIES (DISK_SECTOR_SIZE / sizeof (struct dir_entry))
+#define BUCKET_SIZE (BUCKET_ENTRIES * sizeof (struct dir_entry))
+
+/* Called by entry_scan() with entry E, at byte offset OFS in its
+ * directory.  Returns true to stop the scan. */
+typedef bool entry_visit_func (const struct dir_entry *e, off_t ofs,
+		void *aux);
+
+/* An entry_scan() in progress. */
+struct entry_scan {
+	entry_visit_func *visit;            /* Called on each entry. */
+	void *aux;                          /* Passed to VISIT. */
+	off_t next;                         /* Offset of the next entry. */
+	struct dir_entry part;              /* Entry split across sectors. */
+	size_t part_size;                   /* Bytes of it gathered so far. */
+};
+
+/* What entry_find() looks for. */
+struct entry_match {
+	const char *name;                   /* Name sought, or null. */
+	uint32_t bucket_cnt;                /* Buckets, or 0 if flat. */
+	struct dir_entry *ep;               /* Receives the match, or null. */
+};
+
+/* Where dir_readdir_many() puts what it reads. */
+struct readdir_state {
+	struct dir_record *records;         /* Records to fill. */
+	size_t cnt;                         /* Number of RECORDS. */
+	size_t found;                       /* Records filled so far. */
+	size_t seen;                        /* Entries passed over. */
+	uint32_t bucket_cnt;                /* Buckets, or 0 if flat. */
+};
+
+/* Returns the byte offset of bucket B. */
+static off_t
+bucket_ofs (uint32_t b) {
+	return (off_t) (b + 1) * DISK_SECTOR_SIZE;
+}
+
+/* Returns the bucket NAME belongs in, among BUCKET_CNT. */
+static uint32_t
+name_bucket (const char *name, uint32_t bucket_cnt) {
+	return hash_string (name) & (bucket_cnt - 1);
+}
+
+/* Returns true if E, at byte offset OFS in a directory with BUCKET_CNT
+ * buckets, or 0 if it is flat, is an entry in use. */
+static bool
+entry_live (const struct dir_entry *e, off_t ofs, uint32_t bucket_cnt) {
+	return e->in_use && (bucket_cnt == 0
+			|| name_bucket (e->name, bucket_cnt)
+			== (uint32_t) (ofs / DISK_SECTOR_SIZE - 1));
+}
+
+/* If DIR is indexed, returns its bucket count; otherwise returns 0. */
+static uint32_t
+index_bucket_cnt (const struct dir *dir) {
+	struct dir_entry e;
+	uint32_t bucket_cnt;
+
+	if (inode_read_at (dir->inode, &e, sizeof e, 0) != sizeof e
+			|| e.in_use || e.inode_sector != DIR_INDEX_MAGIC)
+		return 0;
+	memcpy (&bucket_cnt, e.name, sizeof bucket_cnt);
+	return bucket_cnt;
+}
+
+/* inode_scan_func for entry_scan(): passes each entry in the SIZE
+ * bytes at DATA to the scan's visitor, in place, except that an entry
+ * split across two sectors is gathered first. */
+static bool
+scan_entries (const void *data_, off_t ofs UNUSED, int size, void *s_) {
+	const uint8_t *data = data_;
+	struct entry_scan *s = s_;
+
+	while (size > 0) {
+		const struct dir_entry *e = (const struct dir_entry *) data;
+		size_t take = sizeof *e;
+
+		if (s->part_size > 0 || (size_t) size < sizeof *e) {
+			take = sizeof *e - s->part_size;
+			if (take > (size_t) size)
+				take = size;
+			memcpy ((uint8_t *) &s->part + s->part_size, data, take);
+			s->part_size += take;
+			if (s->part_size < sizeof *e)
+				return false;
+			s->part_size = 0;
+			e = &s->part;
+		}
+		data += take;
+		size -= take;
+
+		if (s->visit (e, s->next, s->aux))
+			return true;
+		s->next += sizeof *e;
+	}
+	return false;
+}
+
+/* Passes the entries of DIR between byte offsets OFS and END to VISIT,
+ * in place in the buffer cache, until it returns true.  Returns the
+ * offset of the entry it stopped at, or -1 if it never did. */
+static off_t
+entry_scan (const struct dir *dir, off_t ofs, off_t end,
+		entry_visit_func *visit, void *aux) {
+	struct entry_scan s = {
+		.visit = visit, .aux = aux, .next = ofs, .part_size = 0,
+	};
+
+	return inode_scan (dir->inode, ofs, end, scan_entries, &s) ? s.next : -1;
+}
+
+/* entry_visit_func for entry_find(). */
+static bool
+match_entry (const struct dir_entry *e, off_t ofs, void *m_) {
+	struct entry_match *m = m_;
+	bool live = entry_live (e, ofs, m->bucket_cnt);
+
+	if (m->name != NULL ? !live || strcmp (m->name, e->name) : live)
+		return false;
+	if (m->ep != NULL)
+		*m->ep = *e;
+	return true;
+}
+
+/* Searches the entries of DIR, which has BUCKET_CNT buckets, between
+ * byte offsets OFS and END for one in use named NAME or, if NAME is
+ * null, for one not in use.  Returns the offset of the first match,
+ * after storing it in *EP if EP is non-null, or -1 if there is none. */
+static off_t
+entry_find (const struct dir *dir, uint32_t bucket_cnt, const char *name,
+		off_t ofs, off_t end, struct dir_entry *ep) {
+	struct entry_match m = { .name = name, .bucket_cnt = bucket_cnt, .ep = ep };
+
+	return entry_scan (dir, ofs, end, match_entry, &m);
+}
+
+/* Writes DIR's index header, giving it BUCKET_CNT buckets. */
+static bool
+index_set_bucket_cnt (struct dir *dir, uint32_t bucket_cnt) {
+	struct dir_entry e;
+
+	memset (&e, 0, sizeof e);
+	e.inode_sector = DIR_INDEX_MAGIC;
+	memcpy (e.name, &bucket_cnt, sizeof bucket_cnt);
+	return inode_write_at (dir->inode, &e, sizeof e, 0) == sizeof e;
+}
+
+/* Reads bucket B of DIR into BUCKET. */
+static bool
+bucket_read (const struct dir *dir, uint32_t b, struct dir_entry *bucket) {
+	return inode_read_at (dir->inode, bucket, BUCKET_SIZE, bucket_ofs (b))
+		== BUCKET_SIZE;
+}
+
+/* Writes BUCKET to bucket B of DIR. */
+static bool
+bucket_write (struct dir *dir, uint32_t b, const struct dir_entry *bucket) {
+	return inode_write_at (dir->inode, bucket, BUCKET_SIZE, bucket_ofs (b))
+		== BUCKET_SIZE;
+}
+
+/* Doubles the number of buckets in DIR, which has BUCKET_CNT, by
+ * splitting each bucket B into B and B + BUCKET_CNT.  The entries of B
+ * that belong in the new bucket are copied there, and only then is the
+ * new count written, after which the copies left in B are dead.  Each
+ * step leaves DIR whole, so the running journal transaction may commit
+ * between them, which it must be able to: the steps together may log
+ * more than a transaction holds. */
+static bool
+index_grow (struct dir *dir, uint32_t bucket_cnt) {
+	struct dir_entry *old = malloc (BUCKET_SIZE);
+	struct dir_entry *new = malloc (BUCKET_SIZE);
+	bool success = old != NULL && new != NULL;
+
+	for (uint32_t b = 0; success && b < bucket_cnt; b++) {
+		size_t new_cnt = 0;
+
+		success = bucket_read (dir, b, old);
+		if (!success)
+			break;
+		memset (new, 0, BUCKET_SIZE);
+		for (size_t i = 0; i < BUCKET_ENTRIES; i++)
+			if (entry_live (&old[i], bucket_ofs (b), bucket_cnt)
+					&& name_bucket (old[i].name, bucket_cnt * 2) != b)
+				new[new_cnt++] = old[i];
+		success = bucket_write (dir, b + bucket_cnt, new);
+		journal_checkpoint ();
+	}
+	if (success)
+		success = index_set_bucket_cnt (dir, bucket_cnt * 2);
+
+	free (old);
+	free (new);
+	return success;
+}
+
+/* Places the CNT ENTRIES in INDEX, the image of a directory with
+ * BUCKET_CNT buckets, each in the first free slot of its bucket.
+ * Returns false if a bucket overflows. */
+static bool
+index_place (uint8_t *index, uint32_t bucket_cnt,
+		const struct dir_entry *entries, size_t cnt) {
+	for (size_t i = 0; i < cnt; i++) {
+		uint32_t b = name_bucket (entries[i].name, bucket_cnt);
+		struct dir_entry *bucket = (struct dir_entry *) (index + bucket_ofs (b));
+		size_t j;
+
+		for (j = 0; j < BUCKET_ENTRIES && bucket[j].in_use; j++)
+			continue;
+		if (j == BUCKET_ENTRIES)
+			return false;
+		bucket[j] = entries[i];
+	}
+	return true;
+}
+
+/* Rewrites flat DIR as an index with room for twice its entries,
+ * and returns the bucket count, or 0 on failure.  The index is laid
+ * out in memory, with as many more buckets as it takes for every
+ * entry to fit, and written at once. */
+static uint32_t
+index_create (struct dir *dir) {
+	off_t length = inode_length (dir->inode) / sizeof (struct dir_entry)
+		* sizeof (struct dir_entry);
+	struct dir_entry *entries = malloc (length);
+	uint8_t *index = NULL;
+	size_t entry_cnt = 0;
+	uint32_t bucket_cnt = 4;
+	bool success = false;
+
+	/* Gather the entries in use. */
+	if (entries == NULL
+			|| inode_read_at (dir->inode, entries, length, 0) != length)
+		goto done;
+	for (size_t i = 0; i < length / sizeof *entries; i++)
+		if (entries[i].in_use)
+			entries[entry_cnt++] = entries[i];
+	while (bucket_cnt * BUCKET_ENTRIES < 2 * entry_cnt)
+		bucket_cnt *= 2;
+
+	/* Start over with twice the buckets whenever one overflows. */
+	for (;;) {
+		index = calloc (bucket_cnt + 1, DISK_SECTOR_SIZE);
+		if (index == NULL)
+			goto done;
+		if (index_place (index, bucket_cnt, entries, entry_cnt))
+			break;
+		free (index);
+		index = NULL;
+		bucket_cnt *= 2;
+	}
+
+	/* The header. */
+	struct dir_entry *header = (struct dir_entry *) index;
+	header->inode_sector = DIR_INDEX_MAGIC;
+	memcpy (header->name, &bucket_cnt, sizeof bucket_cnt);
+
+	off_t size = bucket_ofs (bucket_cnt);
+	success = inode_write_at (dir->inode, index, size, 0) == size;
+
+done:
+	free (entries);
+	free (index);
+	return success ? bucket_cnt : 0;
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) {
+	/* SECTOR may have held a directory before: forget its names. */
+	dcache_purge_dir (sector);
 	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
 }
 
@@ -32,6 +325,7 @@ struct dir *
 dir_open (struct inode *inode) {
 	struct dir *dir = calloc (1, sizeof *dir);
 	if (inode != NULL && dir != NULL) {
+		inode_set_journaled (inode);
 		dir->inode = inode;
 		dir->pos = 0;
 		return dir;
@@ -79,22 +373,24 @@ dir_get_inode (struct dir *dir) {
 static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
-	struct dir_entry e;
-	size_t ofs;
+	uint32_t bucket_cnt;
+	off_t ofs;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (e.in_use && !strcmp (name, e.name)) {
-			if (ep != NULL)
-				*ep = e;
-			if (ofsp != NULL)
-				*ofsp = ofs;
-			return true;
-		}
-	return false;
+	bucket_cnt = index_bucket_cnt (dir);
+	if (bucket_cnt != 0) {
+		/* Indexed: search NAME's bucket only. */
+		uint32_t b = name_bucket (name, bucket_cnt);
+		ofs = entry_find (dir, bucket_cnt, name, bucket_ofs (b),
+				bucket_ofs (b) + BUCKET_SIZE, ep);
+	} else
+		ofs = entry_find (dir, 0, name, 0, inode_length (dir->inode), ep);
+
+	if (ofs >= 0 && ofsp != NULL)
+		*ofsp = ofs;
+	return ofs >= 0;
 }
 
 /* Searches DIR for a file with the given NAME
@@ -104,65 +400,131 @@ lookup (const struct dir *dir, const char *name,
 bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
+	disk_sector_t dir_sector = inode_get_inumber (dir->inode);
+	disk_sector_t sector;
 	struct dir_entry e;
+	unsigned gen;
+	bool found;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
-		*inode = inode_open (e.inode_sector);
-	else
-		*inode = NULL;
+	switch (dcache_lookup (dir_sector, name, &sector, &gen)) {
+		case DCACHE_FOUND:
+			*inode = inode_open (sector);
+			break;
+		case DCACHE_ABSENT:
+			*inode = NULL;
+			break;
+		case DCACHE_MISS:
+			inode_lock_read (dir->inode);
+			found = lookup (dir, name, &e, NULL);
+			inode_unlock_read (dir->inode);
+			if (found) {
+				dcache_insert (dir_sector, name, true, e.inode_sector, gen);
+				*inode = inode_open (e.inode_sector);
+			} else {
+				dcache_insert (dir_sector, name, false, 0, gen);
+				*inode = NULL;
+			}
+			break;
+	}
 
 	return *inode != NULL;
 }
 
+/* Returns the byte offset of a free slot for NAME in DIR, which has
+ * BUCKET_CNT buckets: in NAME's bucket, or anywhere in a flat DIR, at
+ * its end if need be.  Returns -1 if NAME's bucket is full. */
+static off_t
+free_slot (const struct dir *dir, uint32_t bucket_cnt, const char *name) {
+	if (bucket_cnt != 0) {
+		uint32_t b = name_bucket (name, bucket_cnt);
+		return entry_find (dir, bucket_cnt, NULL, bucket_ofs (b),
+				bucket_ofs (b) + BUCKET_SIZE, NULL);
+	} else {
+		off_t end = inode_length (dir->inode) / sizeof (struct dir_entry)
+			* sizeof (struct dir_entry);
+		off_t ofs = entry_find (dir, 0, NULL, 0, end, NULL);
+		return ofs >= 0 ? ofs : end;
+	}
+}
+
+/* Prepares DIR for dir_add() to add NAME, which it does in one step:
+ * a full flat directory is indexed, and buckets are split until NAME's
+ * has a free slot, which takes a step per bucket.  Returns false if
+ * NAME is invalid (i.e. too long) or already in DIR, or if a disk or
+ * memory error occurs.
+ * DIR must be locked for writing, and an outermost journal handle
+ * opened afterward, which is checkpointed between the steps. */
+bool
+dir_make_room (struct dir *dir, const char *name) {
+	uint32_t bucket_cnt;
+
+	ASSERT (dir != NULL);
+	ASSERT (name != NULL);
+
+	/* Check NAME for validity. */
+	if (*name == '\0' || strlen (name) > NAME_MAX)
+		return false;
+	if (lookup (dir, name, NULL, NULL))
+		return false;
+
+	bucket_cnt = index_bucket_cnt (dir);
+	if (bucket_cnt == 0) {
+		/* A full flat directory that would grow too long is indexed
+		 * instead. */
+		off_t ofs = free_slot (dir, 0, name);
+		if (ofs / sizeof (struct dir_entry) < DIR_LINEAR_MAX)
+			return true;
+		bucket_cnt = index_create (dir);
+		if (bucket_cnt == 0)
+			return false;
+		journal_checkpoint ();
+	}
+	while (free_slot (dir, bucket_cnt, name) < 0) {
+		if (!index_grow (dir, bucket_cnt))
+			return false;
+		bucket_cnt *= 2;
+		journal_checkpoint ();
+	}
+	return true;
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
  * file by that name.  The file's inode is in sector
  * INODE_SECTOR.
  * Returns true if successful, false on failure.
- * Fails if NAME is invalid (i.e. too long) or a disk or memory
+ * DIR must be locked for writing since dir_make_room() made room for
+ * NAME, without any checkpoint since.  Fails if a disk or memory
  * error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	struct dir_entry e;
 	off_t ofs;
-	bool success = false;
+	bool success;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	/* Check NAME for validity. */
-	if (*name == '\0' || strlen (name) > NAME_MAX)
+	ofs = free_slot (dir, index_bucket_cnt (dir), name);
+	if (ofs < 0)
 		return false;
 
-	/* Check that NAME is not in use. */
-	if (lookup (dir, name, NULL, NULL))
-		goto done;
-
-	/* Set OFS to offset of free slot.
-	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
-
-	 * inode_read_at() will only return a short read at end of file.
-	 * Otherwise, we'd need to verify that we didn't get a short
-	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
-			break;
-
 	/* Write slot. */
 	e.in_use = true;
 	strlcpy (e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
-done:
+	/* Only after the write, so that a lookup racing with it cannot
+	 * cache what it read before. */
+	dcache_invalidate (inode_get_inumber (dir->inode), name);
 	return success;
 }
 
-/* Removes any entry for NAME in DIR.
+/* Removes any entry for NAME in DIR, which must be locked for
+ * writing.
  * Returns true if successful, false on failure,
  * which occurs only if there is no file with the given NAME. */
 bool
@@ -188,6 +550,7 @@ dir_remove (struct dir *dir, const char *name) {
 	e.in_use = false;
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
+	dcache_invalidate (inode_get_inumber (dir->inode), name);
 
 	/* Remove inode. */
 	inode_remove (inode);
@@ -203,14 +566,91 @@ done:
  * contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
-	struct dir_entry e;
+	struct dir_record r;
 
-	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
-		dir->pos += sizeof e;
-		if (e.in_use) {
-			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+	if (dir_readdir_many (dir, &r, 1) == 0)
+		return false;
+	strlcpy (name, r.name, NAME_MAX + 1);
+	return true;
+}
+
+/* entry_visit_func for dir_readdir_many(): records E if it is in use,
+ * and stops once the records are full. */
+static bool
+read_entry (const struct dir_entry *e, off_t ofs, void *r_) {
+	struct readdir_state *r = r_;
+
+	r->seen++;
+	if (entry_live (e, ofs, r->bucket_cnt)) {
+		struct dir_record *record = &r->records[r->found++];
+		record->inumber = e->inode_sector;
+		/* Only files are ever added to a directory. */
+		record->type = DT_REG;
+		strlcpy (record->name, e->name, sizeof record->name);
+	}
+	return r->found == r->cnt;
+}
+
+/* Reads up to CNT of the next entries in DIR into RECORDS, which must
+ * be kernel memory.  The entries are scanned in place in the buffer
+ * cache a sector's worth at a time: one bucket of an indexed
+ * directory, or as many entries of a flat one.  Returns the number of
+ * entries read, 0 once the directory contains no more. */
+size_t
+dir_readdir_many (struct dir *dir, struct dir_record *records, size_t cnt) {
+	struct readdir_state r = { .records = records, .cnt = cnt, .found = 0 };
+
+	inode_lock_read (dir->inode);
+	r.bucket_cnt = index_bucket_cnt (dir);
+	while (r.found < cnt) {
+		off_t size = BUCKET_SIZE;
+
+		/* Start on an entry boundary, even if DIR changed format since
+		 * a position given to dir_seek() was taken. */
+		if (r.bucket_cnt == 0)
+			dir->pos = ROUND_UP (dir->pos, sizeof (struct dir_entry));
+		else {
+			/* Indexed: walk the buckets, skipping the header sector
+			 * and the slack at the end of each bucket. */
+			off_t sector_start = ROUND_DOWN (dir->pos, DISK_SECTOR_SIZE);
+			off_t bucket_pos = ROUND_UP (dir->pos - sector_start,
+					sizeof (struct dir_entry));
+			if (sector_start < bucket_ofs (0)
+					|| bucket_pos >= (off_t) BUCKET_SIZE) {
+				sector_start += DISK_SECTOR_SIZE;
+				bucket_pos = 0;
+			}
+			dir->pos = sector_start + bucket_pos;
+			if (dir->pos >= bucket_ofs (r.bucket_cnt))
+				break;
+			size = BUCKET_SIZE - bucket_pos;
 		}
+
+		/* Consume only the entries that fit in RECORDS. */
+		r.seen = 0;
+		entry_scan (dir, dir->pos, dir->pos + size, read_entry, &r);
+		if (r.seen == 0)
+			break;
+		dir->pos += r.seen * sizeof (struct dir_entry);
 	}
-	return false;
+	inode_unlock_read (dir->inode);
+	return r.found;
+}
+
+/* Sets the position in DIR at which dir_readdir() and
+ * dir_readdir_many() continue to POS, a value returned by
+ * dir_tell(), or 0 for the first entry. */
+void
+dir_seek (struct dir *dir, off_t pos) {
+	ASSERT (dir != NULL);
+	ASSERT (pos >= 0);
+	dir->pos = pos;
+}
+
+/* Returns the position in DIR at which dir_readdir() and
+ * dir_readdir_many() continue. */
+off_t
+dir_tell (struct dir *dir) {
+	ASSERT (dir != NULL);
+	return dir->pos;
 }
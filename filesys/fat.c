@@ -1,4 +1,6 @@
 #include "filesys/fat.h"
+#include <bitmap.h>
+#include <round.h>
 #include "devices/disk.h"
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
@@ -9,7 +11,7 @@
 /* Should be less than DISK_SECTOR_SIZE */
 struct fat_boot {
 	unsigned int magic;
-	unsigned int sectors_per_cluster; /* Fixed to 1 */
+	unsigned int sectors_per_cluster; /* 1 to FAT_MAX_CLUSTER_SECTORS. */
 	unsigned int total_sectors;
 	unsigned int fat_start;
 	unsigned int fat_sectors; /* Size of FAT in sectors. */
@@ -22,14 +24,29 @@ struct fat_fs {
 	unsigned int *fat;
 	unsigned int fat_length;
 	disk_sector_t data_start;
-	cluster_t last_clst;
-	struct lock write_lock;
+	cluster_t last_clst;      /* Last cluster allocated; next-fit hint. */
+	struct lock write_lock;   /* Serializes chain creation and removal. */
+	struct bitmap *used;      /* Clusters in use, one bit per FAT entry. */
+	struct bitmap *dirty;     /* FAT sectors not yet written back. */
 };
 
+/* FAT entries that fit in one sector. */
+#define ENTRIES_PER_SECTOR (DISK_SECTOR_SIZE / sizeof (cluster_t))
+
 static struct fat_fs *fat_fs;
 
+/* Sectors per cluster for the next format (-cluster option).  It is
+ * recorded in the boot sector and sizes the FAT and the root directory
+ * cluster, nothing more: inodes index their data sector by sector and
+ * never walk FAT chains, so no read or write is done a cluster at a
+ * time. */
+unsigned int fat_cluster_sectors = SECTORS_PER_CLUSTER;
+
 void fat_boot_create (void);
 void fat_fs_init (void);
+static cluster_t *fat_table_alloc (void);
+static void fat_maps_create (void);
+static void fat_maps_destroy (void);
 
 void
 fat_init (void) {
@@ -48,36 +65,27 @@ fat_init (void) {
 	// Extract FAT info
 	if (fat_fs->bs.magic != FAT_MAGIC)
 		fat_boot_create ();
+	if (fat_fs->bs.sectors_per_cluster < 1
+			|| fat_fs->bs.sectors_per_cluster > FAT_MAX_CLUSTER_SECTORS)
+		PANIC ("FAT has bad cluster size %u", fat_fs->bs.sectors_per_cluster);
 	fat_fs_init ();
 }
 
 void
 fat_open (void) {
-	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
+	fat_fs->fat = fat_table_alloc ();
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
 
-	// Load FAT directly from the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_read = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_read;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
-			           buffer + bytes_read);
-			bytes_read += DISK_SECTOR_SIZE;
-		} else {
-			uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT load failed");
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			memcpy (buffer + bytes_read, bounce, bytes_left);
-			bytes_read += bytes_left;
-			free (bounce);
-		}
-	}
+	// Load FAT directly from the disk, in as few transfers as possible
+	disk_read_sectors (filesys_disk, fat_fs->bs.fat_start,
+	                   fat_fs->bs.fat_sectors, fat_fs->fat);
+
+	// Derive the free-cluster map from the loaded FAT
+	fat_maps_create ();
+	for (cluster_t clst = 1; clst < fat_fs->fat_length; clst++)
+		if (fat_fs->fat[clst] != 0)
+			bitmap_mark (fat_fs->used, clst);
 }
 
 void
@@ -90,27 +98,32 @@ fat_close (void) {
 	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
 
-	// Write FAT directly to the disk
+	// Write back the FAT sectors changed since the FAT was loaded
+	fat_flush ();
+
+	free (fat_fs->fat);
+	fat_fs->fat = NULL;
+	fat_maps_destroy ();
+}
+
+/* Writes every dirty FAT sector to the disk. */
+void
+fat_flush (void) {
 	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
-		}
+	size_t i = 0;
+
+	// Write each run of consecutive dirty sectors with one transfer
+	lock_acquire (&fat_fs->write_lock);
+	while ((i = bitmap_scan (fat_fs->dirty, i, 1, true)) != BITMAP_ERROR) {
+		size_t end = bitmap_scan (fat_fs->dirty, i, 1, false);
+		if (end == BITMAP_ERROR)
+			end = fat_fs->bs.fat_sectors;
+		disk_write_sectors (filesys_disk, fat_fs->bs.fat_start + i, end - i,
+		                    buffer + i * DISK_SECTOR_SIZE);
+		bitmap_set_multiple (fat_fs->dirty, i, end - i, false);
+		i = end;
 	}
+	lock_release (&fat_fs->write_lock);
 }
 
 void
@@ -119,10 +132,12 @@ fat_create (void) {
 	fat_boot_create ();
 	fat_fs_init ();
 
-	// Create FAT table
-	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
+	// Create FAT table; every sector of it has to reach the disk
+	fat_fs->fat = fat_table_alloc ();
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
+	fat_maps_create ();
+	bitmap_set_all (fat_fs->dirty, true);
 
 	// Set up ROOT_DIR_CLST
 	fat_put (ROOT_DIR_CLUSTER, EOChain);
@@ -131,18 +146,25 @@ fat_create (void) {
 	uint8_t *buf = calloc (1, DISK_SECTOR_SIZE);
 	if (buf == NULL)
 		PANIC ("FAT create failed due to OOM");
-	disk_write (filesys_disk, cluster_to_sector (ROOT_DIR_CLUSTER), buf);
+	disk_sector_t root = cluster_to_sector (ROOT_DIR_CLUSTER);
+	for (unsigned i = 0; i < fat_fs->bs.sectors_per_cluster; i++)
+		disk_write (filesys_disk, root + i, buf);
 	free (buf);
 }
 
 void
 fat_boot_create (void) {
+	ASSERT (fat_cluster_sectors >= 1
+	        && fat_cluster_sectors <= FAT_MAX_CLUSTER_SECTORS);
+
+	/* One FAT sector maps ENTRIES_PER_SECTOR clusters, so larger
+	 * clusters need proportionally fewer FAT sectors. */
 	unsigned int fat_sectors =
 	    (disk_size (filesys_disk) - 1)
-	    / (DISK_SECTOR_SIZE / sizeof (cluster_t) * SECTORS_PER_CLUSTER + 1) + 1;
+	    / (ENTRIES_PER_SECTOR * fat_cluster_sectors + 1) + 1;
 	fat_fs->bs = (struct fat_boot){
 	    .magic = FAT_MAGIC,
-	    .sectors_per_cluster = SECTORS_PER_CLUSTER,
+	    .sectors_per_cluster = fat_cluster_sectors,
 	    .total_sectors = disk_size (filesys_disk),
 	    .fat_start = 1,
 	    .fat_sectors = fat_sectors,
@@ -152,7 +174,46 @@ fat_boot_create (void) {
 
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	/* Clusters follow the FAT.  Entry 0 is never a cluster: a 0 entry
+	 * marks a free cluster and a 0 cluster number means "none". */
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+		/ fat_fs->bs.sectors_per_cluster + 1;
+	if (fat_fs->fat_length > fat_fs->bs.fat_sectors * ENTRIES_PER_SECTOR)
+		fat_fs->fat_length = fat_fs->bs.fat_sectors * ENTRIES_PER_SECTOR;
+	fat_fs->last_clst = ROOT_DIR_CLUSTER;
+	lock_init (&fat_fs->write_lock);
+}
+
+/* Allocates a zeroed in-memory FAT.  It spans every FAT sector, even
+ * past FAT_LENGTH entries, so that the FAT moves to and from the disk
+ * without bounce buffers. */
+static cluster_t *
+fat_table_alloc (void) {
+	return calloc (fat_fs->bs.fat_sectors, DISK_SECTOR_SIZE);
+}
+
+/* Creates the free-cluster and dirty-sector maps for the current
+ * FAT, replacing any old ones.  Cluster 0 is marked in use so that
+ * it is never handed out. */
+static void
+fat_maps_create (void) {
+	fat_maps_destroy ();
+	fat_fs->used = bitmap_create (fat_fs->fat_length);
+	fat_fs->dirty = bitmap_create (fat_fs->bs.fat_sectors);
+	if (fat_fs->used == NULL || fat_fs->dirty == NULL)
+		PANIC ("FAT maps creation failed");
+	bitmap_mark (fat_fs->used, 0);
+}
+
+/* Frees the free-cluster and dirty-sector maps. */
+static void
+fat_maps_destroy (void) {
+	if (fat_fs->used != NULL)
+		bitmap_destroy (fat_fs->used);
+	if (fat_fs->dirty != NULL)
+		bitmap_destroy (fat_fs->dirty);
+	fat_fs->used = fat_fs->dirty = NULL;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -164,30 +225,67 @@ fat_fs_init (void) {
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+
+	/* Next-fit from the last allocation keeps a growing file in
+	 * consecutive clusters; wrap around before giving up. */
+	size_t new = bitmap_scan (fat_fs->used, fat_fs->last_clst, 1, false);
+	if (new == BITMAP_ERROR)
+		new = bitmap_scan (fat_fs->used, 1, 1, false);
+	if (new == BITMAP_ERROR) {
+		lock_release (&fat_fs->write_lock);
+		return 0;
+	}
+
+	fat_put (new, EOChain);
+	if (clst != 0)
+		fat_put (clst, new);
+	fat_fs->last_clst = new;
+
+	lock_release (&fat_fs->write_lock);
+	return new;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	while (clst != 0 && clst != EOChain) {
+		cluster_t next = fat_get (clst);
+		fat_put (clst, 0);
+		clst = next;
+	}
+	if (pclst != 0)
+		fat_put (pclst, EOChain);
+	lock_release (&fat_fs->write_lock);
 }
 
-/* Update a value in the FAT table. */
+/* Update a value in the FAT table.  A VAL of 0 frees CLST; anything
+ * else marks it in use.  Callers changing a chain must hold the FAT's
+ * write lock, as fat_create_chain() and fat_remove_chain() do. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+
+	fat_fs->fat[clst] = val;
+	bitmap_set (fat_fs->used, clst, val != 0);
+	bitmap_mark (fat_fs->dirty, clst / ENTRIES_PER_SECTOR);
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+
+	return fat_fs->fat[clst];
 }
 
-/* Covert a cluster # to a sector number. */
+/* Covert a cluster # to the number of its first sector.  The
+ * cluster's sectors_per_cluster sectors follow it consecutively. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+
+	return fat_fs->data_start + (clst - 1) * fat_fs->bs.sectors_per_cluster;
 }
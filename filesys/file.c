@@ -1,6 +1,9 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include <round.h>
+#include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 
 /* An open file. */
@@ -10,6 +13,44 @@ struct file {
 	bool deny_write;            /* Has file_deny_write() been called? */
 };
 
+/* Most bytes of a write, allocation or punch passed to the inode layer
+ * at once.  The metadata one such step changes fits in the credits of
+ * a journal handle, so a larger call checkpoints between steps.
+ *
+ * Each call locks FILE before opening its handle, as journal_begin()
+ * requires, and holds the lock across its checkpoints. */
+#define FILE_STEP (16 * DISK_SECTOR_SIZE)
+
+/* Returns the end of the step that starts at POS in a range ending at
+ * END: the next multiple of FILE_STEP past POS's sector, or END. */
+static off_t
+step_end (off_t pos, off_t end) {
+	off_t next = ROUND_DOWN (pos, DISK_SECTOR_SIZE) + FILE_STEP;
+	return next < end ? next : end;
+}
+
+/* Writes SIZE bytes from BUFFER into FILE at offset FILE_OFS, a step
+ * at a time.  Must be called with FILE locked for writing and a
+ * journal handle open.  Returns the number of bytes written. */
+static off_t
+write_steps (struct file *file, const void *buffer, off_t size,
+		off_t file_ofs) {
+	const uint8_t *buf = buffer;
+	off_t bytes_written = 0;
+
+	while (bytes_written < size) {
+		off_t pos = file_ofs + bytes_written;
+		off_t step = step_end (pos, file_ofs + size) - pos;
+
+		journal_checkpoint ();
+		off_t n = inode_write_at (file->inode, buf + bytes_written, step, pos);
+		bytes_written += n;
+		if (n < step)
+			break;
+	}
+	return bytes_written;
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
@@ -71,7 +112,9 @@ file_get_inode (struct file *file) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
+	inode_lock_read (file->inode);
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	inode_unlock_read (file->inode);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -83,19 +126,25 @@ file_read (struct file *file, void *buffer, off_t size) {
  * The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
-	return inode_read_at (file->inode, buffer, size, file_ofs);
+	inode_lock_read (file->inode);
+	off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+	inode_unlock_read (file->inode);
+	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at the file's current position.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk is full.
+ * Writing past end of file grows the file.
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
-	off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+	inode_lock_write (file->inode);
+	journal_begin ();
+	off_t bytes_written = write_steps (file, buffer, size, file->pos);
+	journal_end ();
+	inode_unlock_write (file->inode);
 	file->pos += bytes_written;
 	return bytes_written;
 }
@@ -103,14 +152,127 @@ file_write (struct file *file, const void *buffer, off_t size) {
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at offset FILE_OFS in the file.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk is full.
+ * Writing past end of file grows the file.
  * The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
 		off_t file_ofs) {
-	return inode_write_at (file->inode, buffer, size, file_ofs);
+	inode_lock_write (file->inode);
+	journal_begin ();
+	off_t bytes_written = write_steps (file, buffer, size, file_ofs);
+	journal_end ();
+	inode_unlock_write (file->inode);
+	return bytes_written;
+}
+
+/* Reads from FILE, starting at offset FILE_OFS, into the CNT buffers
+ * in VEC, filling each before the next.  The whole read sees FILE
+ * as one write left it, as file_read() does.
+ * Returns the number of bytes actually read, which may be less than
+ * the buffers hold if end of file is reached.
+ * The file's current position is unaffected. */
+off_t
+file_readv_at (struct file *file, const struct file_vec *vec, int cnt,
+		off_t file_ofs) {
+	off_t bytes_read = 0;
+
+	inode_lock_read (file->inode);
+	for (int i = 0; i < cnt; i++) {
+		off_t n = inode_read_at (file->inode, vec[i].base, vec[i].len,
+				file_ofs + bytes_read);
+		bytes_read += n;
+		if (n < (off_t) vec[i].len)
+			break;
+	}
+	inode_unlock_read (file->inode);
+	return bytes_read;
+}
+
+/* Writes the CNT buffers in VEC, one after another, into FILE,
+ * starting at offset FILE_OFS.  Other readers and writers see either
+ * all of it or none of it.
+ * Returns the number of bytes actually written,
+ * which may be less than the buffers hold if the disk is full.
+ * Writing past end of file grows the file.
+ * The file's current position is unaffected. */
+off_t
+file_writev_at (struct file *file, const struct file_vec *vec, int cnt,
+		off_t file_ofs) {
+	off_t bytes_written = 0;
+
+	inode_lock_write (file->inode);
+	journal_begin ();
+	for (int i = 0; i < cnt; i++) {
+		off_t n = write_steps (file, vec[i].base, vec[i].len,
+				file_ofs + bytes_written);
+		bytes_written += n;
+		if (n < (off_t) vec[i].len)
+			break;
+	}
+	journal_end ();
+	inode_unlock_write (file->inode);
+	return bytes_written;
+}
+
+/* Gives FILE disk space for the LENGTH bytes starting at offset
+ * FILE_OFS, without writing them, growing FILE if they pass its end.
+ * Space allocated this way reads as zeros until written.
+ * Returns false if the disk is full.
+ * The file's current position is unaffected. */
+bool
+file_allocate (struct file *file, off_t file_ofs, off_t length) {
+	off_t pos = file_ofs;
+	bool success;
+
+	inode_lock_write (file->inode);
+	journal_begin ();
+	do {
+		off_t next = step_end (pos, file_ofs + length);
+		journal_checkpoint ();
+		success = inode_allocate (file->inode, pos, next - pos);
+		pos = next;
+	} while (success && pos < file_ofs + length);
+	journal_end ();
+	inode_unlock_write (file->inode);
+	return success;
+}
+
+/* Frees the disk space behind the LENGTH bytes starting at offset
+ * FILE_OFS in FILE, which afterward read as zeros.  FILE's length is
+ * unaffected, as is its current position. */
+void
+file_punch (struct file *file, off_t file_ofs, off_t length) {
+	inode_lock_write (file->inode);
+	journal_begin ();
+	/* Nothing past the end of FILE is punched. */
+	if (file_ofs < inode_length (file->inode)) {
+		off_t end = inode_length (file->inode);
+		if (length < end - file_ofs)
+			end = file_ofs + length;
+		for (off_t pos = file_ofs; pos < end; ) {
+			off_t next = step_end (pos, end);
+			journal_checkpoint ();
+			inode_punch (file->inode, pos, next - pos);
+			pos = next;
+		}
+	}
+	journal_end ();
+	inode_unlock_write (file->inode);
+}
+
+/* Makes what has been written to FILE durable: its data, and what it
+ * takes to find the data after a crash, which is committed with the
+ * rest of the running journal transaction.  Unless DATA_ONLY, commits
+ * that transaction even if FILE needs nothing from it, so that, for
+ * example, a name just given to FILE is made durable too.  Returns
+ * once the disk has its write cache flushed.  Must not be called with
+ * any file system lock held. */
+void
+file_sync (struct file *file, bool data_only) {
+	if (inode_sync (file->inode) || !data_only)
+		journal_commit ();
+	disk_flush (filesys_disk);
 }
 
 /* Prevents write operations on FILE's underlying inode
@@ -2,10 +2,14 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/fat.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "filesys/dcache.h"
 #include "filesys/directory.h"
+#include "filesys/page_cache.h"
 #include "devices/disk.h"
 
 /* The disk that contains the file system. */
@@ -21,7 +25,9 @@ filesys_init (bool format) {
 	if (filesys_disk == NULL)
 		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
+	page_cache_init ();
 	inode_init ();
+	dcache_init ();
 
 #ifdef EFILESYS
 	fat_init ();
@@ -33,6 +39,7 @@ filesys_init (bool format) {
 #else
 	/* Original FS */
 	free_map_init ();
+	journal_init (format);
 
 	if (format)
 		do_format ();
@@ -49,8 +56,27 @@ filesys_done (void) {
 #ifdef EFILESYS
 	fat_close ();
 #else
+	inode_flush_all ();
 	free_map_close ();
+	journal_done ();
 #endif
+	page_cache_flush ();
+}
+
+/* Writes every file's data and all metadata to disk and has the disk
+ * flush its write cache, leaving the file system as it would be after
+ * filesys_done().  Must not be called with any file system lock
+ * held. */
+void
+filesys_sync (void) {
+#ifdef EFILESYS
+	fat_flush ();
+#else
+	inode_flush_all ();
+	journal_commit ();
+#endif
+	page_cache_flush ();
+	disk_flush (filesys_disk);
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -60,28 +86,49 @@ filesys_done (void) {
 bool
 filesys_create (const char *name, off_t initial_size) {
 	disk_sector_t inode_sector = 0;
+
+	/* "/" names the root directory itself. */
+	if (!strcmp (name, "/"))
+		return false;
+
 	struct dir *dir = dir_open_root ();
-	bool success = (dir != NULL
+	if (dir == NULL)
+		return false;
+
+	/* The directory is locked before the journal handle is opened, as
+	 * journal_begin() requires, and NAME is given room in it first:
+	 * that may commit the running transaction, which must not hold any
+	 * part of the file yet. */
+	inode_lock_write (dir_get_inode (dir));
+	journal_begin ();
+	bool success = (dir_make_room (dir, name)
 			&& free_map_allocate (1, &inode_sector)
 			&& inode_create (inode_sector, initial_size)
 			&& dir_add (dir, name, inode_sector));
 	if (!success && inode_sector != 0)
 		free_map_release (inode_sector, 1);
+	journal_end ();
+	inode_unlock_write (dir_get_inode (dir));
 	dir_close (dir);
 
 	return success;
 }
 
-/* Opens the file with the given NAME.
+/* Opens the file with the given NAME, or the root directory itself
+ * if NAME is "/".
  * Returns the new file if successful or a null pointer
  * otherwise.
  * Fails if no file named NAME exists,
  * or if an internal memory allocation fails. */
 struct file *
 filesys_open (const char *name) {
-	struct dir *dir = dir_open_root ();
+	struct dir *dir;
 	struct inode *inode = NULL;
 
+	if (!strcmp (name, "/"))
+		return file_open (inode_open (ROOT_DIR_SECTOR));
+
+	dir = dir_open_root ();
 	if (dir != NULL)
 		dir_lookup (dir, name, &inode);
 	dir_close (dir);
@@ -96,7 +143,14 @@ filesys_open (const char *name) {
 bool
 filesys_remove (const char *name) {
 	struct dir *dir = dir_open_root ();
-	bool success = dir != NULL && dir_remove (dir, name);
+	if (dir == NULL)
+		return false;
+
+	inode_lock_write (dir_get_inode (dir));
+	journal_begin ();
+	bool success = dir_remove (dir, name);
+	journal_end ();
+	inode_unlock_write (dir_get_inode (dir));
 	dir_close (dir);
 
 	return success;
@@ -1,12 +1,35 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
-#include "filesys/file.h"
+#include <limits.h>
+#include <round.h>
+#include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
-static struct file *free_map_file;   /* Free map file. */
+static struct inode *free_map_inode; /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct lock free_map_lock;    /* Guards the free map and its file. */
+
+/* Sectors of the free map file that differ from FREE_MAP, one bit
+ * per sector, written back by free_map_flush(). */
+static struct bitmap *free_map_dirty;
+
+/* Where the next allocation starts looking, just past the last. */
+static disk_sector_t free_map_cursor;
+
+/* Free sectors, and how many of those are promised to delayed writes
+ * by free_map_reserve(). */
+static size_t free_map_free;
+static size_t free_map_reserved;
+
+/* Number of free map bits held by one sector of its file. */
+#define BITS_PER_SECTOR (DISK_SECTOR_SIZE * 8)
+
+static void mark_dirty (disk_sector_t sector, size_t cnt);
 
 /* Initializes the free map. */
 void
@@ -16,62 +39,216 @@ free_map_init (void) {
 		PANIC ("bitmap creation failed--disk is too large");
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+	free_map_dirty = bitmap_create (DIV_ROUND_UP (bitmap_size (free_map),
+				BITS_PER_SECTOR));
+	if (free_map_dirty == NULL)
+		PANIC ("bitmap creation failed--disk is too large");
+	free_map_cursor = 0;
+	free_map_free = bitmap_count (free_map, 0, bitmap_size (free_map), false);
+	free_map_reserved = 0;
+	lock_init (&free_map_lock);
+}
+
+/* Records that the bits for CNT sectors starting at SECTOR have
+ * changed. */
+static void
+mark_dirty (disk_sector_t sector, size_t cnt) {
+	size_t first = sector / BITS_PER_SECTOR;
+	size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+	bitmap_set_multiple (free_map_dirty, first, last - first + 1, true);
+}
+
+/* Allocates CNT consecutive sectors, counting them against the
+ * reservation if RESERVED.  Must be called with FREE_MAP_LOCK held. */
+static disk_sector_t
+allocate (size_t cnt, bool reserved) {
+	ASSERT (lock_held_by_current_thread (&free_map_lock));
+
+	if (reserved ? free_map_reserved < cnt
+			: free_map_free - free_map_reserved < cnt)
+		return BITMAP_ERROR;
+	disk_sector_t sector = bitmap_scan_and_flip (free_map, free_map_cursor,
+			cnt, false);
+	if (sector == BITMAP_ERROR && free_map_cursor != 0)
+		sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+	if (sector != BITMAP_ERROR) {
+		mark_dirty (sector, cnt);
+		free_map_cursor = (sector + cnt) % bitmap_size (free_map);
+		free_map_free -= cnt;
+		if (reserved)
+			free_map_reserved -= cnt;
+	}
+	return sector;
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
- * the first into *SECTORP.
+ * the first into *SECTORP.  The search starts where the last one
+ * left off and wraps around to sector 0.  Sectors reserved for
+ * delayed writes are not available.
  * Returns true if successful, false if all sectors were
- * available. */
+ * available.  The change reaches disk at the next
+ * free_map_flush(). */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
-	}
+	lock_acquire (&free_map_lock);
+	disk_sector_t sector = allocate (cnt, false);
+	lock_release (&free_map_lock);
+	if (sector != BITMAP_ERROR)
+		*sectorp = sector;
+	return sector != BITMAP_ERROR;
+}
+
+/* Same as free_map_allocate(), but takes the CNT sectors out of those
+ * set aside by free_map_reserve().  Fails only if no run of CNT free
+ * sectors is left, in which case a shorter one may still be. */
+bool
+free_map_allocate_reserved (size_t cnt, disk_sector_t *sectorp) {
+	lock_acquire (&free_map_lock);
+	disk_sector_t sector = allocate (cnt, true);
+	lock_release (&free_map_lock);
 	if (sector != BITMAP_ERROR)
 		*sectorp = sector;
 	return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Sets CNT free sectors aside, to be allocated later with
+ * free_map_allocate_reserved(), so that a write whose sectors are
+ * allocated only later cannot find the disk full by then.  Returns
+ * false if fewer than CNT sectors are free. */
+bool
+free_map_reserve (size_t cnt) {
+	lock_acquire (&free_map_lock);
+	bool success = free_map_free - free_map_reserved >= cnt;
+	if (success)
+		free_map_reserved += cnt;
+	lock_release (&free_map_lock);
+	return success;
+}
+
+/* Gives back CNT sectors set aside by free_map_reserve() that will not
+ * be allocated after all. */
+void
+free_map_unreserve (size_t cnt) {
+	lock_acquire (&free_map_lock);
+	ASSERT (free_map_reserved >= cnt);
+	free_map_reserved -= cnt;
+	lock_release (&free_map_lock);
+}
+
+/* Makes CNT sectors starting at SECTOR available for use.  The
+ * change reaches disk at the next free_map_flush(). */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
 	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+	mark_dirty (sector, cnt);
+	free_map_free += cnt;
+	lock_release (&free_map_lock);
 }
 
-/* Opens the free map file and reads it from disk. */
+/* On disk, bit K of the free map is bit K % CHAR_BIT of byte
+ * K / CHAR_BIT of its file.  The file is written and read here
+ * through its inode, a sector at a time, rather than by
+ * bitmap_write() and bitmap_read(), which move all of it at once. */
+
+/* Writes the free map bits held by sector IDX of the free map file
+ * to INODE.  Returns true if successful, false otherwise. */
+static bool
+write_sector (struct inode *inode, size_t idx) {
+	static uint8_t buf[DISK_SECTOR_SIZE];
+	size_t start = idx * BITS_PER_SECTOR;
+	size_t cnt = bitmap_size (free_map) - start;
+	off_t size;
+
+	if (cnt > BITS_PER_SECTOR)
+		cnt = BITS_PER_SECTOR;
+	memset (buf, 0, sizeof buf);
+	for (size_t i = 0; i < cnt; i++)
+		if (bitmap_test (free_map, start + i))
+			buf[i / CHAR_BIT] |= 1 << (i % CHAR_BIT);
+
+	size = bitmap_file_size (free_map) - idx * DISK_SECTOR_SIZE;
+	if (size > DISK_SECTOR_SIZE)
+		size = DISK_SECTOR_SIZE;
+	return inode_write_at (inode, buf, size, idx * DISK_SECTOR_SIZE) == size;
+}
+
+/* Writes the sectors of the free map file whose bits changed since
+ * they were last written.  A sector that fails to write stays dirty
+ * and is tried again next time. */
+void
+free_map_flush (void) {
+	lock_acquire (&free_map_lock);
+	if (free_map_inode != NULL) {
+		size_t i = 0;
+		while ((i = bitmap_scan (free_map_dirty, i, 1, true)) != BITMAP_ERROR) {
+			if (write_sector (free_map_inode, i))
+				bitmap_reset (free_map_dirty, i);
+			i++;
+		}
+	}
+	lock_release (&free_map_lock);
+}
+
+/* Opens the free map file and reads it from disk, in as few disk
+ * transfers as its layout allows. */
 void
 free_map_open (void) {
-	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-	if (free_map_file == NULL)
+	size_t size = bitmap_file_size (free_map);
+	uint8_t *buf;
+
+	free_map_inode = inode_open (FREE_MAP_SECTOR);
+	if (free_map_inode == NULL)
 		PANIC ("can't open free map");
-	if (!bitmap_read (free_map, free_map_file))
+	inode_set_journaled (free_map_inode);
+
+	buf = malloc (size);
+	if (buf == NULL || inode_load (free_map_inode, buf, size) != (off_t) size)
 		PANIC ("can't read free map");
+	for (size_t i = 0; i < bitmap_size (free_map); i++)
+		bitmap_set (free_map, i, buf[i / CHAR_BIT] & (1 << (i % CHAR_BIT)));
+	free (buf);
+	free_map_free = bitmap_count (free_map, 0, bitmap_size (free_map), false);
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) {
-	file_close (free_map_file);
+	struct inode *inode = free_map_inode;
+
+	free_map_flush ();
+	lock_acquire (&free_map_lock);
+	free_map_inode = NULL;
+	lock_release (&free_map_lock);
+	inode_close (inode);
 }
 
 /* Creates a new free map file on disk and writes the free map to
  * it. */
 void
 free_map_create (void) {
+	struct inode *inode;
+	size_t sector_cnt;
+
 	/* Create inode. */
 	if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
 		PANIC ("free map creation failed");
 
-	/* Write bitmap to file. */
-	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-	if (free_map_file == NULL)
+	/* Write bitmap to file.  The first pass allocates the file's
+	 * sectors, marking them in the bitmap as it goes; it must not
+	 * write the bitmap back itself, so FREE_MAP_INODE is set only
+	 * afterward, and a second pass records the final bitmap. */
+	inode = inode_open (FREE_MAP_SECTOR);
+	if (inode == NULL)
 		PANIC ("can't open free map");
-	if (!bitmap_write (free_map, free_map_file))
-		PANIC ("can't write free map");
+	inode_set_journaled (inode);
+	sector_cnt = DIV_ROUND_UP (bitmap_file_size (free_map), DISK_SECTOR_SIZE);
+	for (int pass = 0; pass < 2; pass++)
+		for (size_t i = 0; i < sector_cnt; i++)
+			if (!write_sector (inode, i))
+				PANIC ("can't write free map");
+	free_map_inode = inode;
+	bitmap_set_all (free_map_dirty, false);
 }
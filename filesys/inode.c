@@ -1,62 +1,530 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/vm.h"
+#else
+#define file_cache_read(INODE, BUFFER, SIZE, OFFSET) false
+#define file_cache_write(INODE, BUFFER, SIZE, OFFSET) false
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Index layout.  An inode indexes its data sectors directly, then
+ * through one indirect block, then through a doubly indirect block
+ * of indirect blocks. */
+#define DIRECT_CNT 123
+#define INDIRECT_CNT (DISK_SECTOR_SIZE / sizeof (disk_sector_t))
+
+/* Sector 0 holds the free map's inode and never holds file data, so a
+ * zero index entry marks a hole: a sector never written, read as
+ * zeros and allocated only when written. */
+#define NO_SECTOR 0
+
+/* Set in the index entry of a sector that inode_allocate() gave a
+ * file but nothing has written yet.  Its disk contents are stale, so
+ * it reads as zeros and is zeroed when first written. */
+#define SECTOR_UNWRITTEN 0x80000000u
+#define IS_UNWRITTEN(SECTOR) (((SECTOR) & SECTOR_UNWRITTEN) != 0)
+
+/* Data sectors one inode can index. */
+#define SECTOR_MAX (DIRECT_CNT + INDIRECT_CNT + INDIRECT_CNT * INDIRECT_CNT)
+
+/* Longest run the extent cache holds. */
+#define EXTENT_MAX 64
+
+/* Longest run of delayed writes an inode buffers. */
+#define DELALLOC_MAX 64
+
+/* inode_disk flags. */
+#define INODE_INLINE 0x1                /* Data is in the inode itself. */
+
 /* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ * An INODE_INLINE inode, which a file small enough starts out as,
+ * keeps its data where the index would be, so that it takes no
+ * sector besides the inode's own.  It is converted to an indexed one
+ * when it outgrows that space. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
+	unsigned flags;                     /* INODE_INLINE. */
+	union {
+		struct {
+			disk_sector_t direct[DIRECT_CNT];   /* First data sectors. */
+			disk_sector_t indirect;             /* Indirect block. */
+			disk_sector_t doubly_indirect;      /* Block of indirect blocks. */
+		};
+		uint8_t inline_data[(DIRECT_CNT + 2) * sizeof (disk_sector_t)];
+	};
 };
 
-/* Returns the number of sectors to allocate for an inode SIZE
- * bytes long. */
-static inline size_t
-bytes_to_sectors (off_t size) {
-	return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
-}
+/* Most bytes an inline inode holds. */
+#define INLINE_MAX ((off_t) sizeof ((struct inode_disk *) NULL)->inline_data)
 
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in open_inodes. */
+	struct list_elem lru_elem;          /* Element in closed_inodes. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
+	bool journaled;                     /* Data is metadata: journal it. */
+	bool meta_dirty;                    /* Inode or index changed since
+	                                       inode_sync()?  Guarded by LOCK. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rw;                   /* Held across a file read or write. */
+	struct lock lock;                   /* Guards DATA and the extent. */
 	struct inode_disk data;             /* Inode content. */
+
+	/* Extent cache: file sectors [EXT_START, EXT_START + EXT_LEN) are
+	 * disk sectors [EXT_SECTOR, EXT_SECTOR + EXT_LEN).  Sectors are
+	 * never moved once allocated, but punching a hole, preallocating
+	 * and marking an unwritten sector written rewrite index entries
+	 * the cache may cover, so they clear EXT_LEN. */
+	size_t ext_start;
+	size_t ext_len;
+	disk_sector_t ext_sector;
+
+	/* Delayed allocation: file sectors [DA_START, DA_START + DA_CNT)
+	 * were holes when written and are held in DA_BUF, with disk space
+	 * reserved but not chosen, until delalloc_flush() allocates them
+	 * as one run.  Also guarded by LOCK. */
+	size_t da_start;
+	size_t da_cnt;
+	uint8_t *da_buf;
 };
 
+/* Allocates a sector, zeroes it, and stores it in *SECTORP.  The
+ * zeroes are journaled if META, that is, if the sector will hold
+ * metadata.  Returns false if the disk is full. */
+static bool
+sector_alloc (disk_sector_t *sectorp, bool meta) {
+	static char zeros[DISK_SECTOR_SIZE];
+
+	if (!free_map_allocate (1, sectorp))
+		return false;
+	if (meta)
+		journal_write (*sectorp, zeros, 0, DISK_SECTOR_SIZE);
+	else
+		page_cache_write (*sectorp, zeros, 0, DISK_SECTOR_SIZE);
+	return true;
+}
+
+/* Returns the sector in *SLOTP, a field of INODE's on-disk inode.  If
+ * that is a hole and CREATE is true, allocates a sector for it first,
+ * which will hold metadata if META.
+ * Returns NO_SECTOR for a hole left in place. */
+static disk_sector_t
+inode_slot (struct inode *inode, disk_sector_t *slotp, bool create,
+		bool meta) {
+	if (*slotp == NO_SECTOR && create && sector_alloc (slotp, meta))
+		journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	return *slotp;
+}
+
+/* Same as inode_slot() for entry IDX of index block TABLE. */
+static disk_sector_t
+index_slot (disk_sector_t table, size_t idx, bool create, bool meta) {
+	disk_sector_t sector;
+
+	if (table == NO_SECTOR)
+		return NO_SECTOR;
+	page_cache_read (table, &sector, idx * sizeof sector, sizeof sector);
+	if (sector == NO_SECTOR && create && sector_alloc (&sector, meta))
+		journal_write (table, &sector, idx * sizeof sector, sizeof sector);
+	return sector;
+}
+
+/* Returns the disk sector that holds data sector IDX of INODE.  A
+ * hole is filled, along with any index block on the way to it, if
+ * CREATE is true.  Returns NO_SECTOR for a hole left in place or if
+ * the disk is full. */
+static disk_sector_t
+index_to_sector (struct inode *inode, size_t idx, bool create) {
+	struct inode_disk *data = &inode->data;
+	disk_sector_t table;
+
+	bool meta = inode->journaled;
+
+	if (idx < DIRECT_CNT)
+		return inode_slot (inode, &data->direct[idx], create, meta);
+	idx -= DIRECT_CNT;
+
+	if (idx < INDIRECT_CNT) {
+		table = inode_slot (inode, &data->indirect, create, true);
+		return index_slot (table, idx, create, meta);
+	}
+	idx -= INDIRECT_CNT;
+
+	if (idx < INDIRECT_CNT * INDIRECT_CNT) {
+		table = inode_slot (inode, &data->doubly_indirect, create, true);
+		table = index_slot (table, idx / INDIRECT_CNT, create, true);
+		return index_slot (table, idx % INDIRECT_CNT, create, meta);
+	}
+	return NO_SECTOR;
+}
+
+static disk_sector_t unwritten_convert (struct inode *, size_t idx,
+		disk_sector_t);
+
 /* Returns the disk sector that contains byte offset POS within
- * INODE.
- * Returns -1 if INODE does not contain data for a byte at offset
- * POS. */
+ * INODE, filling a hole there first if CREATE is true.  An unwritten
+ * sector comes back with SECTOR_UNWRITTEN set, unless CREATE is true,
+ * in which case it is zeroed and marked written first.
+ * Returns NO_SECTOR for a hole left in place, or if the disk is
+ * full. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (struct inode *inode, off_t pos, bool create) {
+	size_t idx = pos / DISK_SECTOR_SIZE;
+	disk_sector_t sector;
+
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
+	ASSERT (pos >= 0);
+
+	lock_acquire (&inode->lock);
+	if (idx - inode->ext_start < inode->ext_len)
+		sector = inode->ext_sector + (idx - inode->ext_start);
+	else {
+		/* Assume the worst: that a sector was allocated. */
+		if (create)
+			inode->meta_dirty = true;
+		sector = index_to_sector (inode, idx, create);
+		if (sector != NO_SECTOR) {
+			/* Cache the run of contiguous sectors starting here, so
+			 * that sequential access walks the index once per run. */
+			size_t len = 1;
+			while (len < EXTENT_MAX
+					&& index_to_sector (inode, idx + len, false) == sector + len)
+				len++;
+			inode->ext_start = idx;
+			inode->ext_len = len;
+			inode->ext_sector = sector;
+		}
+	}
+	if (create && IS_UNWRITTEN (sector))
+		sector = unwritten_convert (inode, idx, sector);
+	lock_release (&inode->lock);
+	return sector;
+}
+
+/* Points data sector IDX of INODE at SECTOR, allocating any index
+ * block on the way, or at NO_SECTOR to make it a hole.  A direct entry
+ * is set only in memory, for the caller to write out.  Returns false
+ * if the disk is full. */
+static bool
+index_install (struct inode *inode, size_t idx, disk_sector_t sector) {
+	struct inode_disk *data = &inode->data;
+	disk_sector_t table;
+
+	if (idx < DIRECT_CNT) {
+		data->direct[idx] = sector;
+		return true;
+	}
+	idx -= DIRECT_CNT;
+
+	if (idx < INDIRECT_CNT)
+		table = inode_slot (inode, &data->indirect, true, true);
+	else {
+		idx -= INDIRECT_CNT;
+		table = inode_slot (inode, &data->doubly_indirect, true, true);
+		table = index_slot (table, idx / INDIRECT_CNT, true, true);
+		idx %= INDIRECT_CNT;
+	}
+	if (table == NO_SECTOR)
+		return false;
+	journal_write (table, &sector, idx * sizeof sector, sizeof sector);
+	return true;
+}
+
+/* Zeroes SECTOR, the unwritten data sector IDX of INODE, and marks it
+ * written.  Returns SECTOR without SECTOR_UNWRITTEN.  Must be called
+ * with INODE's lock held. */
+static disk_sector_t
+unwritten_convert (struct inode *inode, size_t idx, disk_sector_t sector) {
+	static char zeros[DISK_SECTOR_SIZE];
+
+	ASSERT (lock_held_by_current_thread (&inode->lock));
+
+	sector &= ~SECTOR_UNWRITTEN;
+	if (inode->journaled)
+		journal_write (sector, zeros, 0, DISK_SECTOR_SIZE);
 	else
-		return -1;
+		page_cache_write (sector, zeros, 0, DISK_SECTOR_SIZE);
+	index_install (inode, idx, sector);
+	if (idx < DIRECT_CNT)
+		journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	inode->ext_len = 0;
+	inode->meta_dirty = true;
+	return sector;
+}
+
+/* Allocates disk space for INODE's delayed writes, in as few runs as
+ * the free map allows, writes the data there with one transfer per
+ * run, and only then points the index at it, writing the inode once.
+ * Must be called with INODE's lock held. */
+static void
+delalloc_flush (struct inode *inode) {
+	bool direct = false;
+	size_t done = 0;
+
+	ASSERT (lock_held_by_current_thread (&inode->lock));
+
+	if (inode->da_cnt > 0)
+		inode->meta_dirty = true;
+	while (done < inode->da_cnt) {
+		size_t cnt = inode->da_cnt - done;
+		disk_sector_t sector;
+
+		/* The space is reserved, so some run is always left. */
+		while (!free_map_allocate_reserved (cnt, &sector)) {
+			ASSERT (cnt > 1);
+			cnt /= 2;
+		}
+		page_cache_write_run (sector, cnt,
+				inode->da_buf + done * DISK_SECTOR_SIZE);
+		for (size_t i = 0; i < cnt; i++) {
+			size_t idx = inode->da_start + done + i;
+			if (!index_install (inode, idx, sector + i))
+				free_map_release (sector + i, 1);
+			else if (idx < DIRECT_CNT)
+				direct = true;
+		}
+		done += cnt;
+	}
+	if (direct)
+		journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	inode->da_cnt = 0;
+}
+
+/* Returns BUFFER if it is kernel memory, and otherwise the current
+ * thread's sector buffer, to copy through instead while an inode's
+ * lock is held.  A fault on user memory could need that very lock,
+ * to page in a mapping of the same file. */
+static uint8_t *
+locked_buffer (const void *buffer) {
+	if (is_kernel_vaddr (buffer))
+		return (uint8_t *) buffer;
+	ASSERT (thread_current ()->sector_buf != NULL);
+	return thread_current ()->sector_buf;
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+/* Writes SIZE bytes from BUFFER at OFFSET in INODE, all within one
+ * sector, into INODE's delayed run if that sector is a hole.  A hole
+ * that does not extend the run flushes it and starts a new one.
+ * Returns false, writing nothing, if the sector is allocated, or if
+ * the write cannot be delayed, leaving it to the caller.  A user
+ * BUFFER goes through locked_buffer(). */
+static bool
+delalloc_write (struct inode *inode, const void *buffer, int size,
+		off_t offset) {
+	size_t idx = offset / DISK_SECTOR_SIZE;
+	bool success = false;
+
+	if (idx >= SECTOR_MAX || byte_to_sector (inode, offset, false) != NO_SECTOR)
+		return false;
+
+	uint8_t *src = locked_buffer (buffer);
+	if (src != buffer)
+		memcpy (src, buffer, size);
+	lock_acquire (&inode->lock);
+	if (inode->da_buf == NULL)
+		inode->da_buf = malloc (DELALLOC_MAX * DISK_SECTOR_SIZE);
+	if (inode->da_buf == NULL)
+		goto done;
+
+	if (idx - inode->da_start >= inode->da_cnt) {
+		if (inode->da_cnt == DELALLOC_MAX
+				|| (inode->da_cnt > 0 && idx != inode->da_start + inode->da_cnt))
+			delalloc_flush (inode);
+		if (!free_map_reserve (1))
+			goto done;
+		if (inode->da_cnt == 0)
+			inode->da_start = idx;
+		memset (inode->da_buf + inode->da_cnt++ * DISK_SECTOR_SIZE, 0,
+				DISK_SECTOR_SIZE);
+	}
+	memcpy (inode->da_buf + (idx - inode->da_start) * DISK_SECTOR_SIZE
+			+ offset % DISK_SECTOR_SIZE, src, size);
+	success = true;
+
+done:
+	lock_release (&inode->lock);
+	return success;
+}
+
+/* Reads SIZE bytes at OFFSET in INODE, all within one sector that was
+ * a hole, into BUFFER: from INODE's delayed run if it is there, from
+ * disk if the run was flushed meanwhile, and as zeros otherwise.
+ * A user BUFFER goes through locked_buffer(), as in delalloc_write(). */
+static void
+delalloc_read (struct inode *inode, void *buffer, int size, off_t offset) {
+	size_t idx = offset / DISK_SECTOR_SIZE;
+	int sector_ofs = offset % DISK_SECTOR_SIZE;
+	uint8_t *dst = locked_buffer (buffer);
+	disk_sector_t sector;
+
+	lock_acquire (&inode->lock);
+	if (idx - inode->da_start < inode->da_cnt)
+		memcpy (dst, inode->da_buf + (idx - inode->da_start)
+				* DISK_SECTOR_SIZE + sector_ofs, size);
+	else if ((sector = index_to_sector (inode, idx, false)) != NO_SECTOR
+			&& !IS_UNWRITTEN (sector))
+		page_cache_read (sector, dst, sector_ofs, size);
+	else
+		memset (dst, 0, size);
+	lock_release (&inode->lock);
+	if (dst != buffer)
+		memcpy (buffer, dst, size);
+}
+
+/* Returns true if INODE keeps its data inline. */
+static bool
+inode_is_inline (struct inode *inode) {
+	return (inode->data.flags & INODE_INLINE) != 0;
+}
+
+/* Reads SIZE bytes at OFFSET in INODE, which lie within its length,
+ * into BUFFER if INODE is inline.  Returns false, reading nothing, if
+ * it is not.  A user BUFFER goes through locked_buffer(), as in
+ * delalloc_read(). */
+static bool
+inline_read (struct inode *inode, void *buffer, int size, off_t offset) {
+	/* An inode never becomes inline again. */
+	if (!inode_is_inline (inode))
+		return false;
+
+	uint8_t *dst = locked_buffer (buffer);
+	lock_acquire (&inode->lock);
+	bool is_inline = inode_is_inline (inode);
+	if (is_inline)
+		memcpy (dst, inode->data.inline_data + offset, size);
+	lock_release (&inode->lock);
+	if (is_inline && dst != buffer)
+		memcpy (buffer, dst, size);
+	return is_inline;
+}
+
+/* Converts inline INODE to the indexed layout, moving its data to a
+ * newly allocated first sector.  Returns false, leaving INODE inline,
+ * if the disk is full.  Must be called with INODE's lock held. */
+static bool
+inline_convert (struct inode *inode) {
+	off_t length = inode->data.length;
+	disk_sector_t sector;
+
+	ASSERT (lock_held_by_current_thread (&inode->lock));
+
+	if (!sector_alloc (&sector, inode->journaled))
+		return false;
+	if (inode->journaled)
+		journal_write (sector, inode->data.inline_data, 0, length);
+	else
+		page_cache_write (sector, inode->data.inline_data, 0, length);
+	memset (inode->data.inline_data, 0, INLINE_MAX);
+	inode->data.flags &= ~INODE_INLINE;
+	inode->data.direct[0] = sector;
+	journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	return true;
+}
+
+/* Writes SIZE bytes from BUFFER at OFFSET in INODE, all within one
+ * sector, if INODE is inline and the write fits in INLINE_MAX bytes.
+ * A user BUFFER goes through locked_buffer(), as in inline_read().
+ * The new data is journaled with the inode, which the caller writes
+ * again if the write extends it.  An inline inode that the write does
+ * not fit is converted to the indexed layout, its data moving to a
+ * newly allocated first sector.  Returns true if the data was written
+ * here, false if it is left to the indexed path. */
+static bool
+inline_write (struct inode *inode, const void *buffer, int size,
+		off_t offset) {
+	bool fits = offset + size <= INLINE_MAX;
+
+	if (!inode_is_inline (inode))
+		return false;
+
+	uint8_t *src = locked_buffer (buffer);
+	if (fits && src != buffer)
+		memcpy (src, buffer, size);
+	lock_acquire (&inode->lock);
+	if (!inode_is_inline (inode)) {
+		lock_release (&inode->lock);
+		return false;
+	}
+	inode->meta_dirty = true;
+	if (fits) {
+		memcpy (inode->data.inline_data + offset, src, size);
+		journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+		lock_release (&inode->lock);
+		return true;
+	}
+
+	/* Outgrown.  If the disk is full the inode stays inline, and the
+	 * indexed path then fails to allocate as well. */
+	inline_convert (inode);
+	lock_release (&inode->lock);
+	return false;
+}
+
+/* Releases index block TABLE, which is DEPTH levels above the data
+ * sectors, and everything it indexes. */
+static void
+index_release (disk_sector_t table, int depth) {
+	if (table == NO_SECTOR)
+		return;
+	if (depth > 0)
+		for (size_t i = 0; i < INDIRECT_CNT; i++)
+			index_release (index_slot (table, i, false, false), depth - 1);
+	free_map_release (table & ~SECTOR_UNWRITTEN, 1);
+}
+
+/* Most closed inodes kept for reopening. */
+#define CLOSED_MAX 16
+
+/* Open inodes, keyed by sector, so that opening a single inode twice
+ * returns the same `struct inode'.  Also holds the inodes in
+ * CLOSED_INODES: the most recently closed ones, most recent first,
+ * kept with their on-disk inode so that reopening them costs no
+ * read.  OPEN_INODES_LOCK guards both and every open_cnt. */
+static struct hash open_inodes;
+static struct list closed_inodes;
+static struct lock open_inodes_lock;
+
+/* Returns a hash value for inode I. */
+static uint64_t
+inode_hash (const struct hash_elem *i_, void *aux UNUSED) {
+	const struct inode *i = hash_entry (i_, struct inode, elem);
+	return hash_int (i->sector);
+}
+
+/* Returns true if inode A precedes inode B. */
+static bool
+inode_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct inode *a = hash_entry (a_, struct inode, elem);
+	const struct inode *b = hash_entry (b_, struct inode, elem);
+	return a->sector < b->sector;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	hash_init (&open_inodes, inode_hash, inode_less, NULL);
+	list_init (&closed_inodes);
+	lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -75,22 +543,16 @@ inode_create (disk_sector_t sector, off_t length) {
 	 * one sector in size, and you should fix that. */
 	ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
 
+	/* The data starts out as one hole: sectors are allocated as they
+	 * are first written. */
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
 		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
-			success = true; 
-		} 
+		if (length <= INLINE_MAX)
+			disk_inode->flags = INODE_INLINE;
+		journal_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
+		success = true; 
 		free (disk_inode);
 	}
 	return success;
@@ -101,39 +563,57 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
+	struct inode key;
+	struct hash_elem *e;
 	struct inode *inode;
 
-	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
+	lock_acquire (&open_inodes_lock);
+
+	/* Check whether this inode is already open, or recently closed. */
+	key.sector = sector;
+	e = hash_find (&open_inodes, &key.elem);
+	if (e != NULL) {
+		inode = hash_entry (e, struct inode, elem);
+		if (inode->open_cnt++ == 0)
+			list_remove (&inode->lru_elem);
+		lock_release (&open_inodes_lock);
+		return inode; 
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&open_inodes_lock);
 		return NULL;
+	}
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	hash_insert (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	inode->journaled = false;
+	inode->meta_dirty = false;
+	rwlock_init (&inode->rw);
+	lock_init (&inode->lock);
+	inode->ext_start = inode->ext_len = 0;
+	inode->ext_sector = NO_SECTOR;
+	inode->da_start = inode->da_cnt = 0;
+	inode->da_buf = NULL;
+	page_cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	lock_release (&open_inodes_lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&open_inodes_lock);
 		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+	}
 	return inode;
 }
 
@@ -144,28 +624,173 @@ inode_get_inumber (const struct inode *inode) {
 }
 
 /* Closes INODE and writes it to disk.
- * If this was the last reference to INODE, frees its memory.
- * If INODE was also a removed inode, frees its blocks. */
+ * If this was the last reference to INODE, keeps it among the
+ * recently closed inodes, freeing the least recently closed one if
+ * there are too many.
+ * If INODE was also a removed inode, frees its memory and blocks. */
 void
 inode_close (struct inode *inode) {
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
+	/* Every close gives delayed writes their sectors, without holding
+	 * up other opens and closes meanwhile. */
+	if (!inode->removed) {
+		lock_acquire (&inode->lock);
+		delalloc_flush (inode);
+		lock_release (&inode->lock);
+	}
+
+	lock_acquire (&open_inodes_lock);
+	if (--inode->open_cnt > 0) {
+		lock_release (&open_inodes_lock);
+		return;
+	}
+
 	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
-
-		/* Deallocate blocks if removed. */
-		if (inode->removed) {
-			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
-		}
+	if (inode->removed) {
+		struct inode_disk *data = &inode->data;
+
+		hash_delete (&open_inodes, &inode->elem);
+		lock_release (&open_inodes_lock);
+
+		/* Delayed writes are dropped unwritten. */
+		free_map_unreserve (inode->da_cnt);
+		free (inode->da_buf);
 
+		/* Deallocate blocks. */
+		if (!(data->flags & INODE_INLINE)) {
+			for (size_t i = 0; i < DIRECT_CNT; i++)
+				index_release (data->direct[i], 0);
+			index_release (data->indirect, 1);
+			index_release (data->doubly_indirect, 2);
+		}
+		free_map_release (inode->sector, 1);
 		free (inode); 
+		free_map_flush ();
+		return;
+	}
+
+	/* Usually nothing is left to flush by now. */
+	lock_acquire (&inode->lock);
+	delalloc_flush (inode);
+	free (inode->da_buf);
+	inode->da_buf = NULL;
+	lock_release (&inode->lock);
+
+	list_push_front (&closed_inodes, &inode->lru_elem);
+	if (list_size (&closed_inodes) > CLOSED_MAX) {
+		inode = list_entry (list_pop_back (&closed_inodes), struct inode,
+				lru_elem);
+		hash_delete (&open_inodes, &inode->elem);
+		free (inode);
+	}
+	lock_release (&open_inodes_lock);
+
+	/* Last close is a commit point for any sectors it gained. */
+	free_map_flush ();
+}
+
+/* Allocates and writes out the delayed writes of every open inode, for
+ * shutdown. */
+void
+inode_flush_all (void) {
+	struct hash_iterator i;
+
+	lock_acquire (&open_inodes_lock);
+	hash_first (&i, &open_inodes);
+	while (hash_next (&i)) {
+		struct inode *inode = hash_entry (hash_cur (&i), struct inode, elem);
+		lock_acquire (&inode->lock);
+		delalloc_flush (inode);
+		lock_release (&inode->lock);
+	}
+	lock_release (&open_inodes_lock);
+	free_map_flush ();
+}
+
+/* A run of consecutive sectors gathered by inode_sync(). */
+struct sync_run {
+	disk_sector_t start;
+	size_t cnt;
+};
+
+/* Adds SECTOR, unless it is a hole or unwritten, to RUN, first
+ * writing back the run gathered so far if SECTOR does not extend it. */
+static void
+sync_add (struct sync_run *run, disk_sector_t sector) {
+	if (sector == NO_SECTOR || IS_UNWRITTEN (sector))
+		return;
+	if (run->cnt > 0 && sector == run->start + run->cnt) {
+		run->cnt++;
+		return;
+	}
+	if (run->cnt > 0)
+		page_cache_flush_range (run->start, run->cnt);
+	run->start = sector;
+	run->cnt = 1;
+}
+
+/* Adds index block TABLE, which is DEPTH levels above the data
+ * sectors, and everything it indexes, to RUN.  Returns false if out
+ * of memory. */
+static bool
+sync_table (struct sync_run *run, disk_sector_t table, int depth) {
+	disk_sector_t *entries;
+	bool success = true;
+
+	if (table == NO_SECTOR)
+		return true;
+	sync_add (run, table);
+	entries = malloc (DISK_SECTOR_SIZE);
+	if (entries == NULL)
+		return false;
+	page_cache_read (table, entries, 0, DISK_SECTOR_SIZE);
+	for (size_t i = 0; success && i < INDIRECT_CNT; i++)
+		if (depth > 1)
+			success = sync_table (run, entries[i], depth - 1);
+		else
+			sync_add (run, entries[i]);
+	free (entries);
+	return success;
+}
+
+/* Writes INODE's data to disk: delayed writes get their sectors, and
+ * the cached dirty sectors of the file, its index and its inode are
+ * written back in as few passes over the cache as the layout allows,
+ * except those the journal holds.  Returns true if the inode or its
+ * index changed since the last call, in which case the caller must
+ * also commit the journal for the data to be reachable after a
+ * crash. */
+bool
+inode_sync (struct inode *inode) {
+	struct inode_disk *data = &inode->data;
+	struct sync_run run = { 0, 0 };
+	bool success = true;
+
+	lock_acquire (&inode->lock);
+	delalloc_flush (inode);
+	sync_add (&run, inode->sector);
+	if (!(data->flags & INODE_INLINE)) {
+		for (size_t i = 0; i < DIRECT_CNT; i++)
+			sync_add (&run, data->direct[i]);
+		success = sync_table (&run, data->indirect, 1)
+			&& sync_table (&run, data->doubly_indirect, 2);
 	}
+	if (run.cnt > 0)
+		page_cache_flush_range (run.start, run.cnt);
+
+	/* Out of memory, write back everything instead. */
+	if (!success)
+		page_cache_flush ();
+
+	bool meta_dirty = inode->meta_dirty;
+	inode->meta_dirty = false;
+	lock_release (&inode->lock);
+
+	free_map_flush ();
+	return meta_dirty;
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -178,16 +803,16 @@ inode_remove (struct inode *inode) {
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
  * Returns the number of bytes actually read, which may be less
- * than SIZE if an error occurs or end of file is reached. */
+ * than SIZE if an error occurs or end of file is reached.
+ * BUFFER may be user memory the caller has checked is mapped: data is
+ * copied straight out of the buffer cache into it. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
 		/* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -200,93 +825,383 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		uint8_t *dst = buffer + bytes_read;
+		disk_sector_t sector_idx;
+		if (file_cache_read (inode, dst, chunk_size, offset)) {
+			/* Memory-mapped page: its shared copy is the newest. */
+		} else if (inline_read (inode, dst, chunk_size, offset)) {
+			/* Inline data. */
+		} else if ((sector_idx = byte_to_sector (inode, offset, false))
+				== NO_SECTOR) {
+			/* Hole, or not yet allocated. */
+			delalloc_read (inode, dst, chunk_size, offset);
+		} else if (IS_UNWRITTEN (sector_idx)) {
+			/* Allocated, not yet written. */
+			memset (dst, 0, chunk_size);
+		} else
+			page_cache_read (sector_idx, dst, sector_ofs, chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
+
+	/* A reader that got this far is likely to read on: have the next
+	 * sector cached before it asks. */
+	if (bytes_read > 0 && offset < inode_length (inode)
+			&& !inode_is_inline (inode)) {
+		disk_sector_t next = byte_to_sector (inode, offset, false);
+		if (next != NO_SECTOR && !IS_UNWRITTEN (next))
+			page_cache_readahead (next);
+	}
 
 	return bytes_read;
 }
 
+/* Reads the first SIZE bytes of INODE into BUFFER, which must be
+ * kernel memory, in as few disk transfers as the layout allows:
+ * each run of consecutive sectors is read at once.  For loading file
+ * system metadata such as the free map at mount; it bypasses the
+ * memory-mapped page cache and the file's rw lock.  Returns the
+ * number of bytes read. */
+off_t
+inode_load (struct inode *inode, void *buffer_, off_t size) {
+	uint8_t *buffer = buffer_;
+	off_t ofs = 0;
+
+	if (size > inode_length (inode))
+		size = inode_length (inode);
+	if (inline_read (inode, buffer, size, 0))
+		return size;
+	while (ofs < size) {
+		disk_sector_t first = byte_to_sector (inode, ofs, false);
+		off_t left = size - ofs;
+
+		if (first == NO_SECTOR || IS_UNWRITTEN (first)) {
+			/* Hole, or unwritten. */
+			off_t chunk = left < DISK_SECTOR_SIZE ? left : DISK_SECTOR_SIZE;
+			memset (buffer + ofs, 0, chunk);
+			ofs += chunk;
+		} else if (left < DISK_SECTOR_SIZE) {
+			/* Partial last sector. */
+			page_cache_read (first, buffer + ofs, 0, left);
+			ofs += left;
+		} else {
+			size_t n = 1;
+			while (n < (size_t) (left / DISK_SECTOR_SIZE)
+					&& n < DISK_MAX_TRANSFER
+					&& byte_to_sector (inode, ofs + n * DISK_SECTOR_SIZE,
+						false) == first + n)
+				n++;
+			page_cache_read_run (first, n, buffer + ofs);
+			ofs += n * DISK_SECTOR_SIZE;
+		}
+	}
+	return ofs;
+}
+
+/* Passes the bytes of INODE from OFFSET to END, or to its end if that
+ * comes first, to SCAN a sector at a time without copying them: DATA
+ * points into a pinned buffer cache slot, or into INODE itself with its
+ * lock held, so SCAN must not touch INODE or fault.  Holes read as
+ * zeros.  Like inode_load(), bypasses the memory-mapped page cache.
+ * Stops as soon as SCAN returns true, and returns whether it did. */
+bool
+inode_scan (struct inode *inode, off_t offset, off_t end,
+		inode_scan_func *scan, void *aux) {
+	static const uint8_t zeros[DISK_SECTOR_SIZE];
+	bool stop = false;
+
+	if (end > inode_length (inode))
+		end = inode_length (inode);
+	while (!stop && offset < end) {
+		size_t idx = offset / DISK_SECTOR_SIZE;
+		int sector_ofs = offset % DISK_SECTOR_SIZE;
+		int sector_left = DISK_SECTOR_SIZE - sector_ofs;
+		int chunk_size = end - offset < sector_left ? end - offset : sector_left;
+		const uint8_t *data = NULL;
+
+		/* Inline data, or a delayed write. */
+		lock_acquire (&inode->lock);
+		if (inode_is_inline (inode))
+			data = inode->data.inline_data + offset;
+		else if (idx - inode->da_start < inode->da_cnt)
+			data = inode->da_buf + (idx - inode->da_start) * DISK_SECTOR_SIZE
+				+ sector_ofs;
+		if (data != NULL)
+			stop = scan (data, offset, chunk_size, aux);
+		lock_release (&inode->lock);
+
+		if (data == NULL) {
+			disk_sector_t sector_idx = byte_to_sector (inode, offset, false);
+			if (sector_idx == NO_SECTOR || IS_UNWRITTEN (sector_idx))
+				stop = scan (zeros + sector_ofs, offset, chunk_size, aux);
+			else {
+				data = page_cache_pin (sector_idx);
+				stop = scan (data + sector_ofs, offset, chunk_size, aux);
+				page_cache_unpin (data);
+			}
+		}
+		offset += chunk_size;
+	}
+	return stop;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if the disk fills up or an error occurs.
+ * A write past end of file extends the inode; any gap between the
+ * old end and OFFSET is left as a hole.  BUFFER may be user memory,
+ * as in inode_read_at(). */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
 
 	if (inode->deny_write_cnt)
 		return 0;
 
 	while (size > 0) {
-		/* Sector to write, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
+		/* Starting byte offset within sector. */
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
-		/* Bytes left in inode, bytes left in sector, lesser of the two. */
-		off_t inode_left = inode_length (inode) - offset;
+		/* Number of bytes to actually write into this sector. */
 		int sector_left = DISK_SECTOR_SIZE - sector_ofs;
-		int min_left = inode_left < sector_left ? inode_left : sector_left;
+		int chunk_size = size < sector_left ? size : sector_left;
 
-		/* Number of bytes to actually write into this sector. */
-		int chunk_size = size < min_left ? size : min_left;
-		if (chunk_size <= 0)
+		const uint8_t *src = buffer + bytes_written;
+		disk_sector_t sector_idx;
+		if (file_cache_write (inode, src, chunk_size, offset)) {
+			/* Memory-mapped page: written back when it is unmapped. */
+		} else if (inline_write (inode, src, chunk_size, offset)) {
+			/* Inline data. */
+		} else if (!inode->journaled
+				&& delalloc_write (inode, src, chunk_size, offset)) {
+			/* Hole: allocated along with its neighbors later. */
+		} else if ((sector_idx = byte_to_sector (inode, offset, true))
+				== NO_SECTOR) {
+			/* Disk full, or past the largest file. */
 			break;
-
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		} else if (inode->journaled)
+			journal_write (sector_idx, src, sector_ofs, chunk_size);
+		else
+			page_cache_write (sector_idx, src, sector_ofs, chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
+
+	/* Extend only once the data is in place, so that a concurrent
+	 * reader never sees the new length before the bytes behind it. */
+	lock_acquire (&inode->lock);
+	if (bytes_written > 0 && offset > inode->data.length) {
+		inode->data.length = offset;
+		inode->meta_dirty = true;
+		journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	}
+	lock_release (&inode->lock);
+
+	/* Sectors allocated above join the same transaction.  The free
+	 * map's own writes never allocate. */
+	if (inode->sector != FREE_MAP_SECTOR)
+		free_map_flush ();
 
 	return bytes_written;
 }
 
+/* Gives INODE disk space for the LENGTH bytes at OFFSET without
+ * writing them, extending INODE if they pass its end.  Each hole in
+ * the range gets a sector, taken from the free map in as few
+ * contiguous runs as it allows and marked unwritten: it reads as
+ * zeros until first written.  Returns false, keeping whatever was
+ * allocated but not extending INODE, if the disk fills up or the
+ * range passes the largest file. */
+bool
+inode_allocate (struct inode *inode, off_t offset, off_t length) {
+	off_t end = offset + length;
+	size_t first = offset / DISK_SECTOR_SIZE;
+	size_t last = DIV_ROUND_UP (end, DISK_SECTOR_SIZE);
+	size_t idx = first;
+	size_t holes = 0;
+	bool success = true;
+
+	ASSERT (offset >= 0 && length >= 0);
+
+	if (inode->deny_write_cnt || last > SECTOR_MAX)
+		return false;
+
+	lock_acquire (&inode->lock);
+	if (inode_is_inline (inode) && end > INLINE_MAX
+			&& !inline_convert (inode))
+		success = false;
+	else if (!inode_is_inline (inode)) {
+		delalloc_flush (inode);
+		for (size_t i = first; i < last; i++)
+			if (index_to_sector (inode, i, false) == NO_SECTOR)
+				holes++;
+
+		while (success && holes > 0) {
+			size_t cnt = holes;
+			disk_sector_t sector;
+
+			while (cnt > 0 && !free_map_allocate (cnt, &sector))
+				cnt /= 2;
+			if (cnt == 0) {
+				success = false;
+				break;
+			}
+			holes -= cnt;
+
+			/* Hand the run out to the next CNT holes in order. */
+			for (size_t i = 0; i < cnt; idx++) {
+				if (index_to_sector (inode, idx, false) != NO_SECTOR)
+					continue;
+				if (!index_install (inode, idx,
+							(sector + i) | SECTOR_UNWRITTEN)) {
+					free_map_release (sector + i, cnt - i);
+					success = false;
+					break;
+				}
+				i++;
+			}
+		}
+		inode->ext_len = 0;
+	}
+	if (success && end > inode->data.length)
+		inode->data.length = end;
+	inode->meta_dirty = true;
+	journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	lock_release (&inode->lock);
+
+	free_map_flush ();
+	return success;
+}
+
+/* Zeroes bytes FROM through TO - 1 of INODE, which lie within one
+ * sector, if that sector holds data on disk.  Must be called with
+ * INODE's lock held. */
+static void
+punch_zero (struct inode *inode, off_t from, off_t to) {
+	static char zeros[DISK_SECTOR_SIZE];
+	disk_sector_t sector;
+
+	if (from >= to)
+		return;
+	sector = index_to_sector (inode, from / DISK_SECTOR_SIZE, false);
+	if (sector == NO_SECTOR || IS_UNWRITTEN (sector))
+		return;
+	if (inode->journaled)
+		journal_write (sector, zeros, from % DISK_SECTOR_SIZE, to - from);
+	else
+		page_cache_write (sector, zeros, from % DISK_SECTOR_SIZE, to - from);
+}
+
+/* Gives back the disk space behind the LENGTH bytes at OFFSET in
+ * INODE, up to its end, which stays where it is.  The range reads as
+ * zeros afterward: the sectors wholly inside it become holes, and the
+ * sectors it only partly covers are zeroed in place.  Emptied index
+ * blocks are kept. */
+void
+inode_punch (struct inode *inode, off_t offset, off_t length) {
+	off_t end = inode_length (inode);
+	bool direct = false;
+
+	ASSERT (offset >= 0 && length >= 0);
+
+	if (length < end - offset)
+		end = offset + length;
+	if (inode->deny_write_cnt || offset >= end)
+		return;
+
+#ifdef VM
+	/* Mapped pages hold newer copies than the disk. */
+	static char zeros[DISK_SECTOR_SIZE];
+	for (off_t pos = offset; pos < end; ) {
+		off_t next = ROUND_DOWN (pos, DISK_SECTOR_SIZE) + DISK_SECTOR_SIZE;
+		if (next > end)
+			next = end;
+		file_cache_write (inode, zeros, next - pos, pos);
+		pos = next;
+	}
+#endif
+
+	lock_acquire (&inode->lock);
+	if (inode_is_inline (inode)) {
+		memset (inode->data.inline_data + offset, 0, end - offset);
+		journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	} else {
+		/* A partial last sector at the end of the file goes too. */
+		off_t lo = ROUND_UP (offset, DISK_SECTOR_SIZE);
+		off_t hi = end == inode->data.length
+			? ROUND_UP (end, DISK_SECTOR_SIZE)
+			: ROUND_DOWN (end, DISK_SECTOR_SIZE);
+
+		delalloc_flush (inode);
+		if (hi < lo)
+			punch_zero (inode, offset, end);
+		else {
+			punch_zero (inode, offset, lo);
+			punch_zero (inode, hi, end);
+			for (size_t idx = lo / DISK_SECTOR_SIZE;
+					idx < (size_t) hi / DISK_SECTOR_SIZE; idx++) {
+				disk_sector_t sector = index_to_sector (inode, idx, false);
+				if (sector == NO_SECTOR)
+					continue;
+				index_install (inode, idx, NO_SECTOR);
+				free_map_release (sector & ~SECTOR_UNWRITTEN, 1);
+				if (idx < DIRECT_CNT)
+					direct = true;
+			}
+		}
+		inode->ext_len = 0;
+		if (direct)
+			journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	}
+	inode->meta_dirty = true;
+	lock_release (&inode->lock);
+
+	free_map_flush ();
+}
+
+/* Marks INODE's data as metadata, to be journaled like the inode
+ * itself: directories and the free map. */
+void
+inode_set_journaled (struct inode *inode) {
+	inode->journaled = true;
+}
+
+/* Locks INODE for reading: other readers may hold it too, but no
+ * writer.  A file read holds this across inode_read_at(), so that it
+ * sees a write either entirely or not at all.  The page cache for
+ * memory-mapped files reads and writes the inode without it. */
+void
+inode_lock_read (struct inode *inode) {
+	rwlock_acquire_read (&inode->rw);
+}
+
+/* Undoes inode_lock_read(). */
+void
+inode_unlock_read (struct inode *inode) {
+	rwlock_release_read (&inode->rw);
+}
+
+/* Locks INODE for writing, excluding every other reader and
+ * writer. */
+void
+inode_lock_write (struct inode *inode) {
+	rwlock_acquire_write (&inode->rw);
+}
+
+/* Undoes inode_lock_write(). */
+void
+inode_unlock_write (struct inode *inode) {
+	rwlock_release_write (&inode->rw);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
@@ -0,0 +1,424 @@
+/* journal.c: Write-ahead journal for file system metadata.
+ *
+ * Inode, index, directory and free map sectors are only changed
+ * inside a transaction.  The journal holds every sector a transaction
+ * changes in the buffer cache, where neither eviction nor write-behind
+ * may write it home, until the transaction commits.  A commit writes
+ * the new contents of all of its sectors to the journal region with
+ * one sequential transfer, then a header naming them, and only then
+ * lets them go home.  Once they are home the header is cleared.  A
+ * crash thus leaves each transaction either wholly on disk, wholly
+ * absent, or whole in the journal, from where journal_init() replays
+ * it at the next mount.
+ *
+ * Transactions are grouped: every system call that starts while one
+ * is open joins it, and all of them commit together once they have
+ * finished, when the transaction fills up or when the commit daemon
+ * next wakes up.  File data is not journaled.
+ *
+ * A transaction never logs more than JOURNAL_MAX sectors.  Each system
+ * call is admitted only once the transaction has room for the most it
+ * may log, and one that may log more, such as a large write, stops
+ * between steps at journal_checkpoint(), where the transaction may
+ * commit under it. */
+
+#include "filesys/journal.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/page_cache.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Identifies a journal header. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* New sectors, ones the running transaction does not hold yet, that a
+ * handle may log between being opened and the next checkpoint.  A
+ * handle is opened only once the transaction has room for them. */
+#define JOURNAL_CREDITS 12
+
+/* Sectors kept out of every handle's credits, for writes made without
+ * a handle and as slack for a handle that logs more than its credits.
+ * Once a transaction eats into them it commits as soon as it can. */
+#define JOURNAL_RESERVE 8
+#define JOURNAL_SOFT_MAX (JOURNAL_MAX - JOURNAL_RESERVE)
+
+/* Ticks between commits of a transaction that is not full. */
+#define JOURNAL_COMMIT_TICKS TIMER_FREQ
+
+/* On-disk journal header, at JOURNAL_SECTOR.  The CNT sectors after it
+ * hold the new contents of sectors[0] through sectors[CNT - 1]. */
+struct journal_header {
+	uint32_t magic;                     /* JOURNAL_MAGIC. */
+	uint32_t seq;                       /* Commit sequence number. */
+	uint32_t cnt;                       /* Sectors logged, 0 if none. */
+	disk_sector_t sectors[JOURNAL_MAX]; /* Where the sectors belong. */
+	uint8_t unused[DISK_SECTOR_SIZE - 12
+		- JOURNAL_MAX * sizeof (disk_sector_t)];
+};
+
+/* -journal-crash: at shutdown, leave the last commit in the journal,
+ * as if the machine crashed before any of it went home, for testing
+ * journal_recover(). */
+bool journal_crash;
+
+/* JOURNAL_LOCK guards everything below.  HANDLES counts threads with a
+ * handle open on the running transaction, which holds the CNT sectors
+ * in SECTORS, and RESERVED the credits those handles have left.
+ * COMMIT_WANTED keeps new system calls out so that HANDLES can drain;
+ * COMMITTING is set while a commit is under way and keeps everyone
+ * out.  CHANGED is signaled whenever a handle closes or a commit
+ * ends. */
+static bool enabled;
+static struct lock journal_lock;
+static struct condition changed;
+static int handles;
+static size_t reserved;
+static bool commit_wanted;
+static bool committing;
+static size_t cnt;
+static disk_sector_t sectors[JOURNAL_MAX];
+static uint32_t seq;
+
+static void journal_commitd (void *aux);
+static void write_header (uint32_t hdr_cnt);
+static void commit (bool crash);
+
+/* Sets up the journal.  Unless FORMAT, first replays any transaction
+ * that committed but did not reach its home sectors before the file
+ * system was last shut down. */
+void
+journal_init (bool format) {
+	lock_init (&journal_lock);
+	cond_init (&changed);
+	handles = 0;
+	reserved = 0;
+	commit_wanted = committing = false;
+	cnt = 0;
+	seq = 0;
+
+	if (!format)
+		journal_recover ();
+	write_header (0);
+	enabled = true;
+
+	/* A crash test wants everything since boot in the last commit. */
+	if (!journal_crash)
+		thread_create ("journald", PRI_DEFAULT, journal_commitd, NULL);
+}
+
+/* Writes the journal header with HDR_CNT of the running transaction's
+ * sectors, which must already be in the journal region. */
+static void
+write_header (uint32_t hdr_cnt) {
+	static struct journal_header hdr;
+
+	ASSERT (sizeof hdr == DISK_SECTOR_SIZE);
+	memset (&hdr, 0, sizeof hdr);
+	hdr.magic = JOURNAL_MAGIC;
+	hdr.seq = seq;
+	hdr.cnt = hdr_cnt;
+	memcpy (hdr.sectors, sectors, hdr_cnt * sizeof *sectors);
+	disk_write (filesys_disk, JOURNAL_SECTOR, &hdr);
+}
+
+/* Replays the transaction in the journal region, if any, by copying
+ * each of its sectors home.  Replaying twice does no harm, so a crash
+ * during recovery is recovered from the same way. */
+void
+journal_recover (void) {
+	struct journal_header *hdr = malloc (sizeof *hdr);
+	uint8_t *data = malloc (JOURNAL_MAX * DISK_SECTOR_SIZE);
+	if (hdr == NULL || data == NULL)
+		PANIC ("journal recovery failed");
+
+	disk_read (filesys_disk, JOURNAL_SECTOR, hdr);
+	if (hdr->magic == JOURNAL_MAGIC && hdr->cnt > 0
+			&& hdr->cnt <= JOURNAL_MAX) {
+		printf ("Replaying journal: %"PRIu32" sectors...", hdr->cnt);
+		disk_read_sectors (filesys_disk, JOURNAL_SECTOR + 1, hdr->cnt, data);
+		for (uint32_t i = 0; i < hdr->cnt; i++)
+			disk_write (filesys_disk, hdr->sectors[i],
+					data + i * DISK_SECTOR_SIZE);
+		printf ("done.\n");
+		seq = hdr->seq + 1;
+	}
+
+	free (data);
+	free (hdr);
+}
+
+/* Opens a handle on the running transaction for the running thread,
+ * which holds none, once the transaction has room for the handle's
+ * credits.  A transaction without room for even one more handle is
+ * committed first: by the last handle on it to close, or by this
+ * thread if there is none.  Must be called with JOURNAL_LOCK held. */
+static void
+handle_open (struct thread *t) {
+	while (committing || commit_wanted
+			|| cnt + reserved + JOURNAL_CREDITS > JOURNAL_SOFT_MAX) {
+		if (!committing && cnt + JOURNAL_CREDITS > JOURNAL_SOFT_MAX)
+			commit_wanted = true;
+		if (commit_wanted && !committing && handles == 0) {
+			lock_release (&journal_lock);
+			journal_commit ();
+			lock_acquire (&journal_lock);
+		} else
+			cond_wait (&changed, &journal_lock);
+	}
+	handles++;
+	reserved += JOURNAL_CREDITS;
+	t->journal_credits = JOURNAL_CREDITS;
+}
+
+/* Closes the running thread's handle, giving back the credits it has
+ * left.  Returns true if the transaction now waits on the caller to
+ * commit it.  Must be called with JOURNAL_LOCK held. */
+static bool
+handle_close (struct thread *t) {
+	reserved -= t->journal_credits;
+	t->journal_credits = 0;
+	handles--;
+	cond_broadcast (&changed, &journal_lock);
+	return handles == 0 && commit_wanted && !committing;
+}
+
+/* Opens a handle on the running transaction for a system call that
+ * changes metadata; journal_end() closes it.  Handles nest.  An
+ * outermost handle may wait for a commit, so it must not be opened
+ * with any file system lock held, except the rw lock of the file or
+ * directory the call changes: no thread waits for one of those with a
+ * handle open, since they are always taken before the handle. */
+void
+journal_begin (void) {
+	struct thread *t = thread_current ();
+
+	if (!enabled || t->journal_depth++ > 0)
+		return;
+
+	lock_acquire (&journal_lock);
+	handle_open (t);
+	lock_release (&journal_lock);
+}
+
+/* Closes the handle opened by the matching journal_begin().  The last
+ * handle on a transaction that filled up commits it. */
+void
+journal_end (void) {
+	struct thread *t = thread_current ();
+	bool commit;
+
+	if (!enabled)
+		return;
+	ASSERT (t->journal_depth > 0);
+	if (--t->journal_depth > 0)
+		return;
+
+	lock_acquire (&journal_lock);
+	commit = handle_close (t);
+	lock_release (&journal_lock);
+
+	if (commit)
+		journal_commit ();
+}
+
+/* Marks a point between two steps of a long operation at which the
+ * metadata it has changed so far is consistent by itself, the free
+ * map included, which the caller must have flushed.  Renews the
+ * running thread's credits for the next step, if need be by letting
+ * the transaction commit here and opening a handle on the next one.
+ * Must be called with only an outermost handle open, and under the
+ * same locks as journal_begin(). */
+void
+journal_checkpoint (void) {
+	struct thread *t = thread_current ();
+	size_t used = JOURNAL_CREDITS - t->journal_credits;
+	bool commit;
+
+	if (!enabled)
+		return;
+	ASSERT (t->journal_depth == 1);
+
+	lock_acquire (&journal_lock);
+	if (!commit_wanted && cnt + reserved + used <= JOURNAL_SOFT_MAX) {
+		/* Room to spare: top the credits up in place. */
+		reserved += used;
+		t->journal_credits = JOURNAL_CREDITS;
+		lock_release (&journal_lock);
+		return;
+	}
+	commit = handle_close (t);
+	lock_release (&journal_lock);
+
+	if (commit)
+		journal_commit ();
+
+	lock_acquire (&journal_lock);
+	handle_open (t);
+	lock_release (&journal_lock);
+}
+
+/* Closes every handle the running thread still holds.  Called when a
+ * process exits, which may happen in the middle of a system call
+ * that opened one, so that later commits do not wait on it forever. */
+void
+journal_release (void) {
+	struct thread *t = thread_current ();
+
+	if (t->journal_depth == 0)
+		return;
+	t->journal_depth = 1;
+	journal_end ();
+}
+
+/* Copies SIZE bytes from BUFFER to offset OFS within metadata SECTOR,
+ * as part of the running transaction.  A new sector is charged to the
+ * running thread's credits.
+ *
+ * A write made without a handle gets one of its own that joins the
+ * running transaction without waiting for a wanted commit, and never
+ * commits it, since its caller may hold locks that the open handles
+ * need.  It draws on JOURNAL_RESERVE instead of credits.  Should that
+ * run out, it waits for the transaction to commit, which needs every
+ * open handle to get by without the caller's locks. */
+void
+journal_write (disk_sector_t sector, const void *buffer, int ofs, int size) {
+	struct thread *t = thread_current ();
+	bool own = t->journal_depth == 0;
+	bool hold = false;
+	size_t i;
+
+	if (!enabled) {
+		page_cache_write (sector, buffer, ofs, size);
+		return;
+	}
+
+	lock_acquire (&journal_lock);
+	for (;;) {
+		while (committing)
+			cond_wait (&changed, &journal_lock);
+		for (i = 0; i < cnt; i++)
+			if (sectors[i] == sector)
+				break;
+		if (!own || i < cnt || cnt + reserved < JOURNAL_MAX)
+			break;
+
+		/* No room left: have the transaction commit. */
+		commit_wanted = true;
+		if (handles == 0) {
+			lock_release (&journal_lock);
+			journal_commit ();
+			lock_acquire (&journal_lock);
+		} else
+			cond_wait (&changed, &journal_lock);
+	}
+	if (own) {
+		handles++;
+		t->journal_depth++;
+	}
+	if (i == cnt) {
+		if (t->journal_credits > 0) {
+			t->journal_credits--;
+			reserved--;
+		} else if (cnt + reserved >= JOURNAL_MAX)
+			PANIC ("journal transaction overflow");
+		sectors[cnt++] = sector;
+		hold = true;
+		if (cnt >= JOURNAL_SOFT_MAX)
+			commit_wanted = true;
+	}
+	lock_release (&journal_lock);
+
+	if (hold)
+		page_cache_hold (sector);
+	page_cache_write (sector, buffer, ofs, size);
+
+	if (own) {
+		lock_acquire (&journal_lock);
+		t->journal_depth--;
+		handle_close (t);
+		lock_release (&journal_lock);
+	}
+}
+
+/* Commits the running transaction, waiting first for every handle on
+ * it to close.  The caller must hold no handle and no file system
+ * lock, which a handle might be waiting for. */
+void
+journal_commit (void) {
+	commit (false);
+}
+
+/* Commits the running transaction.  If CRASH, stops as soon as the
+ * commit is in the journal, leaving its sectors held, so that they
+ * never go home and journal_recover() has to finish it. */
+static void
+commit (bool crash) {
+	if (!enabled)
+		return;
+
+	lock_acquire (&journal_lock);
+	while (committing)
+		cond_wait (&changed, &journal_lock);
+	if (cnt == 0 && !commit_wanted) {
+		lock_release (&journal_lock);
+		return;
+	}
+	commit_wanted = true;
+	while (handles > 0)
+		cond_wait (&changed, &journal_lock);
+	committing = true;
+	lock_release (&journal_lock);
+
+	/* Nobody can change a held sector now. */
+	if (cnt > 0) {
+		uint8_t *data = malloc (cnt * DISK_SECTOR_SIZE);
+		if (data == NULL)
+			PANIC ("journal commit failed");
+		for (size_t i = 0; i < cnt; i++)
+			page_cache_read (sectors[i], data + i * DISK_SECTOR_SIZE, 0,
+					DISK_SECTOR_SIZE);
+		disk_write_sectors (filesys_disk, JOURNAL_SECTOR + 1, cnt, data);
+		write_header (cnt);
+		free (data);
+
+		if (crash) {
+			printf ("Crashing with %zu sectors in the journal.\n", cnt);
+			return;
+		}
+
+		/* Committed: the sectors may go home. */
+		for (size_t i = 0; i < cnt; i++)
+			page_cache_unhold (sectors[i]);
+		cnt = 0;
+		write_header (0);
+		seq++;
+	}
+
+	lock_acquire (&journal_lock);
+	committing = commit_wanted = false;
+	cond_broadcast (&changed, &journal_lock);
+	lock_release (&journal_lock);
+}
+
+/* Commits the running transaction and stops journaling, for shutdown. */
+void
+journal_done (void) {
+	commit (journal_crash);
+	enabled = false;
+}
+
+/* Commit daemon: commits the running transaction periodically, so
+ * that a crash loses at most about JOURNAL_COMMIT_TICKS of metadata
+ * changes. */
+static void
+journal_commitd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (JOURNAL_COMMIT_TICKS);
+		journal_commit ();
+	}
+}
@@ -1,50 +1,397 @@
-/* page_cache.c: Implementation of Page Cache (Buffer Cache). */
-
-#include "vm/vm.h"
-static bool page_cache_readahead (struct page *page, void *kva);
-static bool page_cache_writeback (struct page *page);
-static void page_cache_destroy (struct page *page);
-
-/* DO NOT MODIFY this struct */
-static const struct page_operations page_cache_op = {
-	.swap_in = page_cache_readahead,
-	.swap_out = page_cache_writeback,
-	.destroy = page_cache_destroy,
-	.type = VM_PAGE_CACHE,
+/* page_cache.c: Implementation of Page Cache (Buffer Cache).
+ *
+ * Every sector the file system reads or writes goes through a fixed
+ * set of cache slots.  Writes only dirty a slot; dirty slots reach the
+ * disk when they are evicted, when the write-behind daemon wakes up,
+ * or at page_cache_flush().  Readers may also ask for a sector to be
+ * read ahead by a second daemon, so that it is cached by the time a
+ * sequential reader gets to it. */
+
+#include "filesys/page_cache.h"
+#include <debug.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Number of cached sectors. */
+#define CACHE_SLOTS 64
+
+/* Ticks between write-behind passes. */
+#define WRITE_BEHIND_TICKS (5 * TIMER_FREQ)
+
+/* Most sectors waiting to be read ahead; later requests are dropped. */
+#define READAHEAD_QUEUE 16
+
+/* A cached sector. */
+struct cache_slot {
+	disk_sector_t sector;           /* Cached sector, if VALID. */
+	bool valid;                     /* Holds a sector? */
+	bool dirty;                     /* Newer than the disk? */
+	bool accessed;                  /* Used since the clock last passed? */
+	bool io;                        /* Being read or written back. */
+	bool held;                      /* Kept from disk by the journal. */
+	int users;                      /* Copying in or out of DATA. */
+	uint8_t data[DISK_SECTOR_SIZE];
 };
 
-tid_t page_cache_workerd;
+/* SLOT_LOCK guards every field of every slot except DATA, which
+ * belongs to whoever has the slot pinned (USERS > 0) or to the thread
+ * doing its I/O.  A slot is never evicted while pinned or in I/O, and
+ * is neither evicted nor written back while HELD.
+ * IO_DONE is signaled whenever a slot finishes I/O or is unpinned. */
+static struct cache_slot slots[CACHE_SLOTS];
+static struct lock slot_lock;
+static struct condition io_done;
+static size_t clock_hand;
+
+/* Sectors to read ahead, guarded by SLOT_LOCK. */
+static disk_sector_t readahead_queue[READAHEAD_QUEUE];
+static size_t readahead_head, readahead_cnt;
+static struct semaphore readahead_sema;
 
-/* The initializer of file vm */
+static void page_cache_writebehindd (void *aux);
+static void page_cache_readaheadd (void *aux);
+
+/* Initializes the buffer cache and starts its daemons. */
 void
-pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+page_cache_init (void) {
+	lock_init (&slot_lock);
+	cond_init (&io_done);
+	sema_init (&readahead_sema, 0);
+	clock_hand = 0;
+	readahead_head = readahead_cnt = 0;
+
+	thread_create ("writebehindd", PRI_DEFAULT, page_cache_writebehindd, NULL);
+	thread_create ("readaheadd", PRI_DEFAULT, page_cache_readaheadd, NULL);
+}
+
+/* Returns the slot caching SECTOR, or a null pointer. */
+static struct cache_slot *
+slot_find (disk_sector_t sector) {
+	for (size_t i = 0; i < CACHE_SLOTS; i++)
+		if (slots[i].valid && slots[i].sector == sector)
+			return &slots[i];
+	return NULL;
+}
+
+/* Writes SLOT back to disk.  Drops SLOT_LOCK during the write.
+ * SLOT stays usable by threads that already pinned it; anything they
+ * write meanwhile dirties it again. */
+static void
+slot_write_back (struct cache_slot *slot) {
+	ASSERT (lock_held_by_current_thread (&slot_lock));
+	ASSERT (slot->valid && slot->dirty && !slot->io);
+
+	slot->io = true;
+	slot->dirty = false;
+	lock_release (&slot_lock);
+	disk_write (filesys_disk, slot->sector, slot->data);
+	lock_acquire (&slot_lock);
+	slot->io = false;
+	cond_broadcast (&io_done, &slot_lock);
+}
+
+/* Chooses a slot to reuse with the clock algorithm: a slot used since
+ * the hand last passed is skipped once.  Returns a null pointer if
+ * every slot is pinned or in I/O. */
+static struct cache_slot *
+slot_choose_victim (void) {
+	for (size_t i = 0; i < 2 * CACHE_SLOTS; i++) {
+		struct cache_slot *slot = &slots[clock_hand];
+		clock_hand = (clock_hand + 1) % CACHE_SLOTS;
+
+		if (!slot->valid)
+			return slot;
+		if (slot->users > 0 || slot->io || slot->held)
+			continue;
+		if (slot->accessed) {
+			slot->accessed = false;
+			continue;
+		}
+		return slot;
+	}
+	return NULL;
+}
+
+/* Returns the slot caching SECTOR, loading SECTOR into a free or
+ * evicted slot if it is not cached.  If FILL is false the caller
+ * overwrites the whole sector, so it is not read from disk.
+ * Must be called with SLOT_LOCK held; may drop it while waiting for
+ * I/O.  The slot returned is not in I/O. */
+static struct cache_slot *
+slot_get (disk_sector_t sector, bool fill) {
+	ASSERT (lock_held_by_current_thread (&slot_lock));
+
+	for (;;) {
+		struct cache_slot *slot = slot_find (sector);
+		if (slot != NULL) {
+			if (slot->io) {
+				cond_wait (&io_done, &slot_lock);
+				continue;
+			}
+			slot->accessed = true;
+			return slot;
+		}
+
+		slot = slot_choose_victim ();
+		if (slot == NULL) {
+			cond_wait (&io_done, &slot_lock);
+			continue;
+		}
+		if (slot->valid && slot->dirty) {
+			/* Another thread may load SECTOR meanwhile, so look
+			 * again once the victim is clean. */
+			slot_write_back (slot);
+			continue;
+		}
+
+		slot->sector = sector;
+		slot->valid = true;
+		slot->dirty = false;
+		slot->held = false;
+		slot->accessed = true;
+		if (fill) {
+			slot->io = true;
+			lock_release (&slot_lock);
+			disk_read (filesys_disk, sector, slot->data);
+			lock_acquire (&slot_lock);
+			slot->io = false;
+			cond_broadcast (&io_done, &slot_lock);
+		}
+		return slot;
+	}
+}
+
+/* Returns the cached contents of SECTOR, reading it in if need be,
+ * and pins its slot: the contents stay where they are, and may be
+ * read in place, until page_cache_unpin().  A pinned slot is only
+ * written by the file system's writers, which callers lock out. */
+const void *
+page_cache_pin (disk_sector_t sector) {
+	lock_acquire (&slot_lock);
+	struct cache_slot *slot = slot_get (sector, true);
+	slot->users++;
+	lock_release (&slot_lock);
+	return slot->data;
 }
 
-/* Initialize the page cache */
-bool
-page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
-	/* Set up the handler */
-	page->operations = &page_cache_op;
+/* Unpins the slot whose contents page_cache_pin() returned as DATA. */
+void
+page_cache_unpin (const void *data) {
+	struct cache_slot *slot = (struct cache_slot *) ((const uint8_t *) data
+			- offsetof (struct cache_slot, data));
 
+	lock_acquire (&slot_lock);
+	ASSERT (slot->users > 0);
+	slot->users--;
+	cond_broadcast (&io_done, &slot_lock);
+	lock_release (&slot_lock);
 }
 
-/* Utilze the Swap in mechanism to implement readhead */
-static bool
-page_cache_readahead (struct page *page, void *kva) {
+/* Copies SIZE bytes at offset OFS within SECTOR into BUFFER, straight
+ * out of its cache slot.  BUFFER may be user memory the caller has
+ * checked is mapped: a fault on it only pages it in, and the slot
+ * stays pinned meanwhile, so no lock is held across the copy. */
+void
+page_cache_read (disk_sector_t sector, void *buffer, int ofs, int size) {
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	const uint8_t *data = page_cache_pin (sector);
+	memcpy (buffer, data + ofs, size);
+	page_cache_unpin (data);
 }
 
-/* Utilze the Swap out mechanism to implement writeback */
-static bool
-page_cache_writeback (struct page *page) {
+/* Copies SIZE bytes from BUFFER, which may be user memory as in
+ * page_cache_read(), to offset OFS within SECTOR.  The sector is read
+ * first only if the write does not cover all of it. */
+void
+page_cache_write (disk_sector_t sector, const void *buffer, int ofs,
+		int size) {
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&slot_lock);
+	struct cache_slot *slot = slot_get (sector, size < DISK_SECTOR_SIZE);
+	slot->users++;
+	lock_release (&slot_lock);
+
+	memcpy (slot->data + ofs, buffer, size);
+
+	lock_acquire (&slot_lock);
+	slot->dirty = true;
+	slot->users--;
+	cond_broadcast (&io_done, &slot_lock);
+	lock_release (&slot_lock);
 }
 
-/* Destory the page_cache. */
+/* Copies the CNT whole sectors starting at SECTOR into BUFFER, which
+ * must be kernel memory.  Cached sectors are copied from the cache, so
+ * unwritten data is seen; each run of uncached sectors is read with a
+ * single disk transfer and not cached, so a bulk load does not evict
+ * everything else.  A sector uncached when checked but written while
+ * the run is read would be missed, so this is only for metadata loads
+ * done before the file system is shared, such as at mount. */
+void
+page_cache_read_run (disk_sector_t sector, size_t cnt, void *buffer_) {
+	uint8_t *buffer = buffer_;
+
+	while (cnt > 0) {
+		size_t run = 0;
+
+		lock_acquire (&slot_lock);
+		bool cached = slot_find (sector) != NULL;
+		if (!cached)
+			while (run < cnt && run < DISK_MAX_TRANSFER
+					&& slot_find (sector + run) == NULL)
+				run++;
+		lock_release (&slot_lock);
+
+		if (cached) {
+			page_cache_read (sector, buffer, 0, DISK_SECTOR_SIZE);
+			run = 1;
+		} else
+			disk_read_sectors (filesys_disk, sector, run, buffer);
+
+		sector += run;
+		buffer += run * DISK_SECTOR_SIZE;
+		cnt -= run;
+	}
+}
+
+/* Writes the CNT whole sectors in BUFFER, which must be kernel memory,
+ * to CNT sectors starting at SECTOR.  Cached sectors are written in
+ * the cache; each run of uncached sectors is written with a single
+ * disk transfer and not cached.  For newly allocated sectors that
+ * nothing indexes yet: a sector read into the cache while its run is
+ * written, by read-ahead queued before it was freed, is brought up to
+ * date afterward. */
+void
+page_cache_write_run (disk_sector_t sector, size_t cnt,
+		const void *buffer_) {
+	const uint8_t *buffer = buffer_;
+
+	while (cnt > 0) {
+		size_t run = 0;
+
+		lock_acquire (&slot_lock);
+		bool cached = slot_find (sector) != NULL;
+		if (!cached)
+			while (run < cnt && run < DISK_MAX_TRANSFER
+					&& slot_find (sector + run) == NULL)
+				run++;
+		lock_release (&slot_lock);
+
+		if (cached) {
+			page_cache_write (sector, buffer, 0, DISK_SECTOR_SIZE);
+			run = 1;
+		} else {
+			disk_write_sectors (filesys_disk, sector, run, buffer);
+
+			lock_acquire (&slot_lock);
+			for (size_t i = 0; i < run; i++) {
+				struct cache_slot *slot;
+				while ((slot = slot_find (sector + i)) != NULL && slot->io)
+					cond_wait (&io_done, &slot_lock);
+				if (slot != NULL)
+					memcpy (slot->data, buffer + i * DISK_SECTOR_SIZE,
+							DISK_SECTOR_SIZE);
+			}
+			lock_release (&slot_lock);
+		}
+
+		sector += run;
+		buffer += run * DISK_SECTOR_SIZE;
+		cnt -= run;
+	}
+}
+
+/* Asks for SECTOR to be read into the cache in the background.  The
+ * request is dropped if SECTOR is already cached or too many are
+ * waiting. */
+void
+page_cache_readahead (disk_sector_t sector) {
+	lock_acquire (&slot_lock);
+	bool queued = slot_find (sector) == NULL
+		&& readahead_cnt < READAHEAD_QUEUE;
+	if (queued)
+		readahead_queue[(readahead_head + readahead_cnt++)
+			% READAHEAD_QUEUE] = sector;
+	lock_release (&slot_lock);
+
+	if (queued)
+		sema_up (&readahead_sema);
+}
+
+/* Writes every dirty slot back to disk. */
+void
+page_cache_flush (void) {
+	page_cache_flush_range (0, (disk_sector_t) -1);
+}
+
+/* Writes back the dirty slots caching any of the CNT sectors starting
+ * at SECTOR, except those the journal holds. */
+void
+page_cache_flush_range (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&slot_lock);
+	for (size_t i = 0; i < CACHE_SLOTS; i++) {
+		struct cache_slot *slot = &slots[i];
+		while (slot->io)
+			cond_wait (&io_done, &slot_lock);
+		if (slot->valid && slot->dirty && !slot->held
+				&& slot->sector - sector < cnt)
+			slot_write_back (slot);
+	}
+	lock_release (&slot_lock);
+}
+
+/* Caches SECTOR and keeps it from reaching the disk, by eviction or
+ * write-back, until page_cache_unhold().  For the journal, which
+ * holds each sector of a transaction until it commits; it must hold
+ * few enough that the cache does not run out of slots. */
+void
+page_cache_hold (disk_sector_t sector) {
+	lock_acquire (&slot_lock);
+	slot_get (sector, true)->held = true;
+	lock_release (&slot_lock);
+}
+
+/* Lets held SECTOR reach the disk again, writing it back now if it is
+ * dirty. */
+void
+page_cache_unhold (disk_sector_t sector) {
+	lock_acquire (&slot_lock);
+	struct cache_slot *slot = slot_find (sector);
+	ASSERT (slot != NULL && slot->held);
+	slot->held = false;
+	while (slot->io)
+		cond_wait (&io_done, &slot_lock);
+	if (slot->valid && slot->sector == sector && slot->dirty)
+		slot_write_back (slot);
+	lock_release (&slot_lock);
+}
+
+/* Write-behind daemon: flushes the cache periodically, so that a crash
+ * loses at most a few seconds of writes. */
 static void
-page_cache_destroy (struct page *page) {
+page_cache_writebehindd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (WRITE_BEHIND_TICKS);
+		page_cache_flush ();
+	}
 }
 
-/* Worker thread for page cache */
+/* Read-ahead daemon: loads queued sectors into the cache. */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_readaheadd (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&readahead_sema);
+
+		lock_acquire (&slot_lock);
+		disk_sector_t sector = readahead_queue[readahead_head];
+		readahead_head = (readahead_head + 1) % READAHEAD_QUEUE;
+		readahead_cnt--;
+		slot_get (sector, true);
+		lock_release (&slot_lock);
+	}
 }
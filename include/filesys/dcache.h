@@ -0,0 +1,22 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Result of a dentry cache lookup. */
+enum dcache_result {
+	DCACHE_MISS,                /* Nothing cached for the name. */
+	DCACHE_FOUND,               /* The name exists. */
+	DCACHE_ABSENT,              /* The name is known not to exist. */
+};
+
+void dcache_init (void);
+enum dcache_result dcache_lookup (disk_sector_t dir, const char *name,
+		disk_sector_t *sectorp, unsigned *genp);
+void dcache_insert (disk_sector_t dir, const char *name, bool exists,
+		disk_sector_t sector, unsigned gen);
+void dcache_invalidate (disk_sector_t dir, const char *name);
+void dcache_purge_dir (disk_sector_t dir);
+
+#endif /* filesys/dcache.h */
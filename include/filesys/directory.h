@@ -3,7 +3,9 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "devices/disk.h"
+#include "filesys/off_t.h"
 
 /* Maximum length of a file name component.
  * This is the traditional UNIX maximum length.
@@ -13,6 +15,19 @@
 
 struct inode;
 
+/* Types of dir_record. */
+#define DT_REG 1                        /* Regular file. */
+#define DT_DIR 2                        /* Directory. */
+
+/* An entry read by dir_readdir_many().  Laid out like the user
+ * programs' struct dirent, so that an array of these can be copied
+ * out as is. */
+struct dir_record {
+	disk_sector_t inumber;              /* Inode sector. */
+	uint8_t type;                       /* DT_REG or DT_DIR. */
+	char name[NAME_MAX + 1];            /* Null terminated file name. */
+};
+
 /* Opening and closing directories. */
 bool dir_create (disk_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
@@ -23,8 +38,12 @@ struct inode *dir_get_inode (struct dir *);
 
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
+bool dir_make_room (struct dir *, const char *name);
 bool dir_add (struct dir *, const char *name, disk_sector_t);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+size_t dir_readdir_many (struct dir *, struct dir_record *, size_t cnt);
+void dir_seek (struct dir *, off_t);
+off_t dir_tell (struct dir *);
 
 #endif /* filesys/directory.h */
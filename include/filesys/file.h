@@ -1,10 +1,20 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 
 struct inode;
 
+/* One buffer of a vectored read or write.  Laid out like the user
+ * programs' struct iovec, so that an array of those can be passed
+ * as is. */
+struct file_vec {
+	void *base;                 /* Start of the buffer. */
+	size_t len;                 /* Its length in bytes. */
+};
+
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
@@ -17,6 +27,17 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_readv_at (struct file *, const struct file_vec *, int cnt,
+		off_t start);
+off_t file_writev_at (struct file *, const struct file_vec *, int cnt,
+		off_t start);
+
+/* Allocating and deallocating space. */
+bool file_allocate (struct file *, off_t start, off_t length);
+void file_punch (struct file *, off_t start, off_t length);
+
+/* Durability. */
+void file_sync (struct file *, bool data_only);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
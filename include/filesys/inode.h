@@ -7,6 +7,11 @@
 
 struct bitmap;
 
+/* Called by inode_scan() with the SIZE bytes at OFFSET in an inode,
+ * in place at DATA.  Returns true to stop the scan. */
+typedef bool inode_scan_func (const void *data, off_t offset, int size,
+		void *aux);
+
 void inode_init (void);
 bool inode_create (disk_sector_t, off_t);
 struct inode *inode_open (disk_sector_t);
@@ -14,8 +19,20 @@ struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+void inode_flush_all (void);
+bool inode_sync (struct inode *);
+void inode_set_journaled (struct inode *);
+off_t inode_load (struct inode *, void *, off_t size);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+bool inode_scan (struct inode *, off_t offset, off_t end,
+		inode_scan_func *, void *aux);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+bool inode_allocate (struct inode *, off_t offset, off_t length);
+void inode_punch (struct inode *, off_t offset, off_t length);
+void inode_lock_read (struct inode *);
+void inode_unlock_read (struct inode *);
+void inode_lock_write (struct inode *);
+void inode_unlock_write (struct inode *);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
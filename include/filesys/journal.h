@@ -0,0 +1,25 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Most sectors one transaction logs.  The journal region is a header
+ * sector followed by this many sectors. */
+#define JOURNAL_MAX 40
+#define JOURNAL_SECTORS (1 + JOURNAL_MAX)
+
+extern bool journal_crash;
+
+void journal_init (bool format);
+void journal_recover (void);
+void journal_begin (void);
+void journal_end (void);
+void journal_checkpoint (void);
+void journal_release (void);
+void journal_write (disk_sector_t sector, const void *buffer, int ofs,
+		int size);
+void journal_commit (void);
+void journal_done (void);
+
+#endif /* filesys/journal.h */
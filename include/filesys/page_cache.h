@@ -1,12 +1,21 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
 
-struct page;
-enum vm_type;
-
-struct page_cache {};
+#include <stddef.h>
+#include "devices/disk.h"
 
 void page_cache_init (void);
-bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+const void *page_cache_pin (disk_sector_t sector);
+void page_cache_unpin (const void *data);
+void page_cache_read (disk_sector_t sector, void *buffer, int ofs, int size);
+void page_cache_write (disk_sector_t sector, const void *buffer, int ofs,
+		int size);
+void page_cache_read_run (disk_sector_t sector, size_t cnt, void *buffer);
+void page_cache_write_run (disk_sector_t sector, size_t cnt,
+		const void *buffer);
+void page_cache_readahead (disk_sector_t sector);
+void page_cache_flush (void);
+void page_cache_flush_range (disk_sector_t sector, size_t cnt);
+void page_cache_hold (disk_sector_t sector);
+void page_cache_unhold (disk_sector_t sector);
 #endif
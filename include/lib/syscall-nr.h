@@ -36,6 +36,35 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Memory advice, project 3. */
+	SYS_MADVISE,                /* Give a hint about a range's access pattern. */
+	SYS_MLOCK,                  /* Pin a range in memory. */
+	SYS_MUNLOCK,                /* Undo mlock. */
+	SYS_MEMSTAT,                /* Report memory usage. */
+	SYS_MEMLIMIT,               /* Limit resident memory. */
+
+	/* Positional and vectored file I/O. */
+	SYS_PREAD,                  /* Read from a file at an offset. */
+	SYS_PWRITE,                 /* Write to a file at an offset. */
+	SYS_READV,                  /* Read from a file into several buffers. */
+	SYS_WRITEV,                 /* Write several buffers to a file. */
+	SYS_SENDFILE,               /* Copy from a file to another fd. */
+
+	/* Durability. */
+	SYS_FSYNC,                  /* Write a file's data and metadata to disk. */
+	SYS_FDATASYNC,              /* Write a file's data to disk. */
+	SYS_SYNC,                   /* Write everything to disk. */
+	SYS_FALLOCATE,              /* Allocate or free a file's space. */
+
+	/* Batched directory reading. */
+	SYS_GETDENTS,               /* Read many directory entries at once. */
 };
 
+/* Most buffers readv() and writev() take at once. */
+#define IOV_MAX 64
+
+/* fallocate() mode: free the range's space instead of allocating. */
+#define FALLOC_FL_PUNCH_HOLE 0x1
+
 #endif /* lib/syscall-nr.h */
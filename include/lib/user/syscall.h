@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <syscall-nr.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -13,9 +14,41 @@ typedef int pid_t;
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
 
+/* Advice values for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect random page references. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential page references. */
+#define MADV_WILLNEED 3         /* Will need these pages. */
+#define MADV_DONTNEED 4         /* Don't need these pages. */
+
+/* Memory usage of a process, in pages, reported by memstat(). */
+struct memstat {
+	size_t resident;        /* In physical memory. */
+	size_t swapped;         /* In swap. */
+	size_t shared;          /* Resident pages of memory-mapped files. */
+	size_t resident_limit;  /* Set by memlimit(), 0 if none. */
+};
+
+/* A buffer for readv() and writev(). */
+struct iovec {
+	void *iov_base;         /* Start of the buffer. */
+	size_t iov_len;         /* Its length in bytes. */
+};
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* A directory entry written by getdents(). */
+struct dirent {
+	unsigned d_ino;                     /* Inode number. */
+	unsigned char d_type;               /* DT_REG or DT_DIR. */
+	char d_name[READDIR_MAX_LEN + 1];   /* Null terminated file name. */
+};
+
+/* Values of d_type. */
+#define DT_REG 1                /* Regular file. */
+#define DT_DIR 2                /* Directory. */
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -35,12 +68,27 @@ int write (int fd, const void *buffer, unsigned length);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
+int pread (int fd, void *buffer, unsigned length, off_t offset);
+int pwrite (int fd, const void *buffer, unsigned length, off_t offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int sendfile (int out_fd, int in_fd, unsigned length);
+int fsync (int fd);
+int fdatasync (int fd);
+void sync (void);
+int fallocate (int fd, int mode, off_t offset, off_t length);
+int getdents (int fd, struct dirent *entries, int cnt);
 
 int dup2(int oldfd, int newfd);
 
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+int mlock (const void *addr, size_t length);
+int munlock (const void *addr, size_t length);
+int memstat (struct memstat *);
+int memlimit (size_t pages);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
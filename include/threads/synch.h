@@ -49,6 +49,25 @@ void cond_signal(struct condition *, struct lock *);
 
 void cond_broadcast(struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock {
+    struct lock lock;       /* Guards the fields below. */
+    struct condition cond;  /* Signaled when RW may have become free. */
+    int readers;            /* Number of threads holding it to read. */
+    bool writer;            /* Held by a writer? */
+    int waiting_writers;    /* Writers waiting to acquire it. */
+};
+
+void rwlock_init(struct rwlock *);
+
+void rwlock_acquire_read(struct rwlock *);
+
+void rwlock_release_read(struct rwlock *);
+
+void rwlock_acquire_write(struct rwlock *);
+
+void rwlock_release_write(struct rwlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
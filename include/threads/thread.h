@@ -112,6 +112,12 @@ struct thread
 #ifdef VM
     /* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
+	uintptr_t user_rsp; /* User rsp at the last system call. */
+#endif
+#ifdef FILESYS
+	int journal_depth; /* Nesting of open journal handles. */
+	int journal_credits; /* Sectors its handle may still log. */
+	uint8_t *sector_buf; /* Stands in for user memory under inode locks. */
 #endif
 
     /* Owned by thread.c. */
@@ -15,7 +15,7 @@ void process_exit(void);
 
 void process_activate(struct thread *next);
 
-void argument_stack(char **parse, int count, void **rsp);
+bool argument_stack(char **parse, int count, void **rsp);
 
 int process_add_file(struct file *f);
 
@@ -4,10 +4,17 @@
 struct page;
 enum vm_type;
 
+/* Swap slot index meaning "not in swap". */
+#define SWAP_SLOT_NONE ((size_t) -1)
+
 struct anon_page {
+	size_t swap_slot;           /* Slot holding the contents, if swapped. */
+	bool zero_fill;             /* Started out zeroed rather than loaded
+	                             * from a file: a stack or BSS page. */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void anon_discard (struct page *page);
 
 #endif
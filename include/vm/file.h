@@ -5,13 +5,28 @@
 
 struct page;
 enum vm_type;
+struct inode;
+struct cache_page;
 
+/* A page of a memory-mapped file.  Before the first fault, a copy of
+ * this struct is the uninit page's aux. */
 struct file_page {
+	struct inode *inode;        /* Mapped file, reference held by the page. */
+	off_t ofs;                  /* Page-aligned offset of the page in it. */
+	void *map_addr;             /* Address returned by the mmap() call. */
+	struct cache_page *cpage;   /* Shared contents while resident. */
 };
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
+bool file_backed_copy (struct page *src);
+void file_backed_discard (struct page *page);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+
+bool file_cache_read (struct inode *inode, void *buffer, off_t size,
+		off_t offset);
+bool file_cache_write (struct inode *inode, const void *buffer, off_t size,
+		off_t offset);
 #endif
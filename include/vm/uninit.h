@@ -1,12 +1,24 @@
 #ifndef VM_UNINIT_H
 #define VM_UNINIT_H
 #include "vm/vm.h"
+#include "filesys/off_t.h"
 
 struct page;
+struct file;
 enum vm_type;
 
 typedef bool vm_initializer (struct page *, void *aux);
 
+/* Auxiliary data of a lazily loaded page: READ_BYTES bytes of FILE
+ * starting at OFS, followed by ZERO_BYTES zero bytes.  A null FILE
+ * means the running process's executable. */
+struct lazy_load_info {
+	struct file *file;
+	off_t ofs;
+	size_t read_bytes;
+	size_t zero_bytes;
+};
+
 /* Uninitlialized page. The type for implementing the
  * "Lazy loading". */
 struct uninit_page {
@@ -1,6 +1,8 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <hash.h>
+#include <list.h>
 #include "threads/palloc.h"
 
 enum vm_type {
@@ -24,12 +26,32 @@ enum vm_type {
 	VM_MARKER_END = (1 << 31),
 };
 
+/* Access pattern hint given by madvise().
+ * Values must match the MADV_* constants in lib/user/syscall.h. */
+enum vm_advice {
+	VM_ADV_NORMAL = 0,          /* No special treatment. */
+	VM_ADV_RANDOM = 1,          /* Expect random access: no readahead. */
+	VM_ADV_SEQUENTIAL = 2,      /* Expect sequential access: read ahead
+	                             * aggressively, evict soon after use. */
+	VM_ADV_WILLNEED = 3,        /* Fault the range in now. */
+	VM_ADV_DONTNEED = 4,        /* Release the range's frames and swap now. */
+};
+
+/* Number of pages brought in after a fault on a VM_ADV_SEQUENTIAL page. */
+#define VM_READAHEAD_PAGES 8
+
+/* User stack.  The stack grows down from USER_STACK to at most
+ * vm_stack_limit bytes, and never to within VM_STACK_GUARD_PAGES of
+ * another mapping.  After VM_STACK_STREAK faults that each grow it by
+ * the next page down, it is grown VM_STACK_CHUNK_PAGES at a time. */
+#define VM_STACK_LIMIT (1 << 20)
+#define VM_STACK_GUARD_PAGES 16
+#define VM_STACK_STREAK 4
+#define VM_STACK_CHUNK_PAGES 8
+
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
-#ifdef EFILESYS
-#include "filesys/page_cache.h"
-#endif
 
 struct page_operations;
 struct thread;
@@ -46,6 +68,10 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	struct hash_elem spt_elem;  /* Element in supplemental page table. */
+	bool writable;              /* Mapped read/write? */
+	bool locked;                /* mlock()'d: never chosen for eviction. */
+	enum vm_advice advice;      /* Last madvise() hint for this page. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -53,16 +79,25 @@ struct page {
 		struct uninit_page uninit;
 		struct anon_page anon;
 		struct file_page file;
-#ifdef EFILESYS
-		struct page_cache page_cache;
-#endif
 	};
 };
 
 /* The representation of "frame" */
 struct frame {
-	void *kva;
+	void *kva;                  /* NULL once released by a page that
+	                             * shares its memory with other frames. */
 	struct page *page;
+	struct thread *owner;       /* Process whose pml4 maps this frame. */
+	struct list_elem elem;      /* Element in the frame table. */
+	bool pinned;                /* Being filled or drained: not evictable. */
+	bool evicting;              /* Being written out by vm_evict_frame(). */
+
+	/* A huge frame backs the HPG_PAGES pages from PAGE->va with one
+	 * 2 MB mapping.  Everything needed to split it back into one
+	 * frame per page is reserved up front, so splitting cannot fail. */
+	bool huge;
+	struct list slices;         /* Frames for the other pages, in order. */
+	uint64_t *split_pt;         /* Page table to map them with. */
 };
 
 /* The function table for page operations.
@@ -85,9 +120,31 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
+	struct hash pages;          /* All pages of the process, keyed by va. */
+
+	/* Usage in pages.  RESIDENT and SHARED are guarded by the frame
+	 * lock, SWAPPED by the swap lock. */
+	size_t resident;            /* Mapped to a frame. */
+	size_t swapped;             /* Held in a swap slot. */
+	size_t shared;              /* Resident file pages, in the page cache. */
+	size_t resident_limit;      /* Most RESIDENT should reach; 0: none. */
+
+	void *stack_bottom;         /* Lowest stack page allocated. */
+	unsigned stack_streak;      /* Consecutive one-page growth faults. */
+};
+
+/* Memory usage of a process, in pages.
+ * Layout must match struct memstat in lib/user/syscall.h. */
+struct vm_usage {
+	size_t resident;
+	size_t swapped;
+	size_t shared;
+	size_t resident_limit;
 };
 
 #include "threads/thread.h"
+extern size_t vm_stack_limit;
+
 void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
 		struct supplemental_page_table *src);
@@ -108,5 +165,15 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
+void vm_free_frame (struct page *page);
+bool vm_hold_page (struct page *page);
+void *vm_page_kva (struct page *page);
+
+bool vm_madvise (void *addr, size_t length, enum vm_advice advice);
+bool vm_mlock (void *addr, size_t length, bool lock);
+void vm_get_usage (struct vm_usage *usage);
+void vm_set_resident_limit (size_t limit);
+bool vm_is_stack_access (void *addr, uintptr_t rsp);
+bool vm_stack_prefault (size_t size);
 
 #endif  /* VM_VM_H */
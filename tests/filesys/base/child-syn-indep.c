@@ -0,0 +1,48 @@
+/* Child process for syn-indep test.
+   Creates a file of its own, writes it a chunk at a time, and
+   reads every chunk back.  Other processes are doing the same
+   with other files at the same time. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-indep.h"
+
+char buf1[BUF_SIZE];
+char buf2[BUF_SIZE];
+
+int
+main (int argc, char *argv[])
+{
+  char file_name[16];
+  int child_idx;
+  int fd;
+  int i;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (file_name, sizeof file_name, "indep%d", child_idx);
+
+  random_init (child_idx);
+  random_bytes (buf1, sizeof buf1);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (i = 0; i < CHUNK_CNT; i++)
+    CHECK (write (fd, buf1 + i * CHUNK_SIZE, CHUNK_SIZE) == CHUNK_SIZE,
+           "write \"%s\"", file_name);
+
+  seek (fd, 0);
+  for (i = 0; i < CHUNK_CNT; i++)
+    CHECK (read (fd, buf2 + i * CHUNK_SIZE, CHUNK_SIZE) == CHUNK_SIZE,
+           "read \"%s\"", file_name);
+  compare_bytes (buf2, buf1, sizeof buf1, 0, file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  return child_idx;
+}
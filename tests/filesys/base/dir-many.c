@@ -0,0 +1,79 @@
+/* Creates enough files in the root directory for it to be indexed,
+   then checks that each can be found, removed, and created again. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 200
+
+static void
+name_file (char *name, size_t size, int i)
+{
+  snprintf (name, size, "file%d", i);
+}
+
+/* Checks that file I exists and is I bytes long if EXISTS is
+   true, or does not exist otherwise. */
+static void
+check_entry (int i, bool exists)
+{
+  char name[16];
+  int fd;
+
+  name_file (name, sizeof name, i);
+  fd = open (name);
+  if (!exists)
+    {
+      if (fd >= 0)
+        fail ("\"%s\" still exists after remove", name);
+      return;
+    }
+  if (fd < 2)
+    fail ("open \"%s\" failed", name);
+  if (filesize (fd) != i)
+    fail ("\"%s\" is %d bytes, expected %d", name, filesize (fd), i);
+  close (fd);
+}
+
+void
+test_main (void)
+{
+  char name[16];
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      name_file (name, sizeof name, i);
+      if (!create (name, i))
+        fail ("create \"%s\" failed", name);
+    }
+  msg ("created %d files", FILE_CNT);
+
+  for (i = 0; i < FILE_CNT; i++)
+    check_entry (i, true);
+  msg ("opened %d files", FILE_CNT);
+
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      name_file (name, sizeof name, i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+  for (i = 0; i < FILE_CNT; i++)
+    check_entry (i, i % 2);
+  msg ("removed every other file");
+
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      name_file (name, sizeof name, i);
+      if (!create (name, i))
+        fail ("re-create \"%s\" failed", name);
+      if (create (name, i))
+        fail ("created \"%s\" twice", name);
+    }
+  for (i = 0; i < FILE_CNT; i++)
+    check_entry (i, true);
+  msg ("re-created removed files");
+}
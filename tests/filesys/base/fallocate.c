@@ -0,0 +1,48 @@
+/* Preallocates space for a file with fallocate(), checking that the
+   file grows and reads as zeros, then writes it, punches a hole
+   through it and checks that the hole reads as zeros while the
+   rest is left intact and the file keeps its size. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 20000
+#define HOLE_OFS 700
+#define HOLE_SIZE 9000
+
+static char buf[FILE_SIZE];
+static char zeros[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (create ("prealloc", 0), "create \"prealloc\"");
+  CHECK ((fd = open ("prealloc")) > 1, "open \"prealloc\"");
+  CHECK (fallocate (fd, 0, 0, FILE_SIZE) == 0, "fallocate \"prealloc\"");
+  CHECK (filesize (fd) == FILE_SIZE, "check size of \"prealloc\"");
+  seek (fd, 0);
+  check_file_handle (fd, "prealloc", zeros, FILE_SIZE);
+
+  random_bytes (buf, sizeof buf);
+  seek (fd, 0);
+  CHECK (write (fd, buf, FILE_SIZE) == FILE_SIZE, "write \"prealloc\"");
+  CHECK (fallocate (fd, FALLOC_FL_PUNCH_HOLE, HOLE_OFS, HOLE_SIZE) == 0,
+         "punch hole in \"prealloc\"");
+  CHECK (filesize (fd) == FILE_SIZE, "check size of \"prealloc\" again");
+  memset (buf + HOLE_OFS, 0, HOLE_SIZE);
+  seek (fd, 0);
+  check_file_handle (fd, "prealloc", buf, FILE_SIZE);
+
+  CHECK (fallocate (fd, 2, 0, 512) == -1, "bad mode (must return -1)");
+  CHECK (fallocate (fd, 0, 0, 0) == -1, "zero length (must return -1)");
+  CHECK (fallocate (STDOUT_FILENO, 0, 0, 512) == -1,
+         "fallocate stdout (must return -1)");
+  msg ("close \"prealloc\"");
+  close (fd);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fallocate) begin
+(fallocate) create "prealloc"
+(fallocate) open "prealloc"
+(fallocate) fallocate "prealloc"
+(fallocate) check size of "prealloc"
+(fallocate) verified contents of "prealloc"
+(fallocate) write "prealloc"
+(fallocate) punch hole in "prealloc"
+(fallocate) check size of "prealloc" again
+(fallocate) verified contents of "prealloc"
+(fallocate) bad mode (must return -1)
+(fallocate) zero length (must return -1)
+(fallocate) fallocate stdout (must return -1)
+(fallocate) close "prealloc"
+(fallocate) end
+EOF
+pass;
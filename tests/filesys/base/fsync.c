@@ -0,0 +1,34 @@
+/* Writes a file and makes it durable with fsync(), fdatasync()
+   and sync(), checking that each succeeds and leaves the data
+   intact, and that fsync() rejects fds that are not files. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[5000];
+
+void
+test_main (void) 
+{
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("durable", 0), "create \"durable\"");
+  CHECK ((fd = open ("durable")) > 1, "open \"durable\"");
+  CHECK (write (fd, buf, 3000) == 3000, "write \"durable\"");
+  CHECK (fsync (fd) == 0, "fsync \"durable\"");
+  CHECK (write (fd, buf + 3000, sizeof buf - 3000) == sizeof buf - 3000,
+         "write more to \"durable\"");
+  CHECK (fdatasync (fd) == 0, "fdatasync \"durable\"");
+  msg ("sync");
+  sync ();
+  CHECK (fsync (STDOUT_FILENO) == -1, "fsync stdout (must return -1)");
+  CHECK (fsync (fd + 100) == -1, "fsync bad fd (must return -1)");
+  msg ("close \"durable\"");
+  close (fd);
+
+  check_file ("durable", buf, sizeof buf);
+}
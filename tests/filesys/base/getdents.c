@@ -0,0 +1,91 @@
+/* Creates enough files in the root directory for it to be indexed,
+   then opens it as "/" and lists it with getdents(), a few entries
+   and then many at a time, checking that each file is listed exactly
+   once, as a regular file with an inode number.  Also checks that
+   getdents() refuses a regular file and read() refuses the
+   directory. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 60
+
+static struct dirent entries[FILE_CNT + 16];
+
+/* Lists the root directory, open as DIR_FD, from the start BATCH
+   entries at a time and checks that it holds each of the files
+   created. */
+static void
+list_files (int dir_fd, int batch)
+{
+  bool seen[FILE_CNT];
+  int listed = 0;
+  int n;
+
+  memset (seen, 0, sizeof seen);
+  seek (dir_fd, 0);
+  while ((n = getdents (dir_fd, entries, batch)) > 0)
+    {
+      int i;
+
+      if (n > batch)
+        fail ("getdents returned %d entries, asked for %d", n, batch);
+      for (i = 0; i < n; i++)
+        {
+          struct dirent *e = &entries[i];
+          int idx;
+
+          if (e->d_type != DT_REG)
+            fail ("\"%s\" has type %d", e->d_name, e->d_type);
+          if (e->d_ino == 0)
+            fail ("\"%s\" has no inode number", e->d_name);
+          if (memcmp (e->d_name, "file", 4))
+            continue;
+          idx = atoi (e->d_name + 4);
+          if (idx < 0 || idx >= FILE_CNT)
+            fail ("unexpected entry \"%s\"", e->d_name);
+          if (seen[idx])
+            fail ("\"%s\" listed twice", e->d_name);
+          seen[idx] = true;
+          listed++;
+        }
+    }
+  if (n < 0)
+    fail ("getdents failed");
+  if (listed != FILE_CNT)
+    fail ("listed %d files, expected %d", listed, FILE_CNT);
+  if (getdents (dir_fd, entries, batch) != 0)
+    fail ("getdents did not stay at the end");
+}
+
+void
+test_main (void)
+{
+  char name[16];
+  char byte;
+  int dir_fd, file_fd;
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+  msg ("created %d files", FILE_CNT);
+
+  CHECK ((dir_fd = open ("/")) > 1, "open \"/\"");
+  list_files (dir_fd, 7);
+  msg ("listed them 7 at a time");
+  list_files (dir_fd, FILE_CNT + 16);
+  msg ("listed them all at once");
+
+  CHECK (read (dir_fd, &byte, 1) == -1, "read directory must fail");
+  CHECK ((file_fd = open ("file0")) > 1, "open \"file0\"");
+  CHECK (getdents (file_fd, entries, 1) == -1,
+         "getdents on a regular file must fail");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(getdents) begin
+(getdents) created 60 files
+(getdents) open "/"
+(getdents) listed them 7 at a time
+(getdents) listed them all at once
+(getdents) read directory must fail
+(getdents) open "file0"
+(getdents) getdents on a regular file must fail
+(getdents) end
+EOF
+pass;
@@ -0,0 +1,58 @@
+/* Creates a large file, which should cost no more than a small
+   one, then checks that it reads as zeros throughout, and that a
+   block written into the middle of it reads back correctly while
+   everything around it still reads as zeros. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (1024 * 1024)
+#define BLOCK_SIZE 1000
+#define BLOCK_OFS 500000
+
+static char zeros[BLOCK_SIZE];
+static char block[BLOCK_SIZE];
+static char buf[BLOCK_SIZE];
+
+/* Reads BLOCK_SIZE bytes at OFS from FD and checks them against
+   EXPECTED. */
+static void
+check_block (int fd, unsigned ofs, const char *expected)
+{
+  seek (fd, ofs);
+  if (read (fd, buf, sizeof buf) != sizeof buf)
+    fail ("read %zu bytes at offset %u failed", sizeof buf, ofs);
+  compare_bytes (buf, expected, sizeof buf, ofs, "sparse");
+}
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (create ("sparse", FILE_SIZE), "create \"sparse\"");
+  CHECK ((fd = open ("sparse")) > 1, "open \"sparse\"");
+  CHECK (filesize (fd) == FILE_SIZE, "check size of \"sparse\"");
+
+  msg ("check that \"sparse\" reads as zeros");
+  check_block (fd, 0, zeros);
+  check_block (fd, BLOCK_OFS, zeros);
+  check_block (fd, FILE_SIZE - BLOCK_SIZE, zeros);
+
+  random_bytes (block, sizeof block);
+  seek (fd, BLOCK_OFS);
+  CHECK (write (fd, block, sizeof block) == sizeof block,
+         "write block into \"sparse\"");
+  CHECK (filesize (fd) == FILE_SIZE, "check size of \"sparse\" again");
+
+  msg ("check contents of \"sparse\"");
+  check_block (fd, BLOCK_OFS - BLOCK_SIZE, zeros);
+  check_block (fd, BLOCK_OFS, block);
+  check_block (fd, BLOCK_OFS + BLOCK_SIZE, zeros);
+
+  msg ("close \"sparse\"");
+  close (fd);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lg-sparse) begin
+(lg-sparse) create "sparse"
+(lg-sparse) open "sparse"
+(lg-sparse) check size of "sparse"
+(lg-sparse) check that "sparse" reads as zeros
+(lg-sparse) write block into "sparse"
+(lg-sparse) check size of "sparse" again
+(lg-sparse) check contents of "sparse"
+(lg-sparse) close "sparse"
+(lg-sparse) end
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Copies most of a file into another with sendfile(), starting
+   partway in, and checks the copy and both file positions. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 10000
+#define SKIP 1234
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  int src, dst;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("src", 0), "create \"src\"");
+  CHECK ((src = open ("src")) > 1, "open \"src\"");
+  CHECK (write (src, buf, sizeof buf) == sizeof buf, "write \"src\"");
+
+  CHECK (create ("dst", 0), "create \"dst\"");
+  CHECK ((dst = open ("dst")) > 1, "open \"dst\"");
+
+  seek (src, SKIP);
+  CHECK (sendfile (dst, src, FILE_SIZE) == FILE_SIZE - SKIP,
+         "sendfile \"src\" to \"dst\"");
+  CHECK (tell (src) == FILE_SIZE, "tell \"src\"");
+  CHECK (tell (dst) == FILE_SIZE - SKIP, "tell \"dst\"");
+  msg ("close \"src\"");
+  close (src);
+  msg ("close \"dst\"");
+  close (dst);
+
+  check_file ("dst", buf + SKIP, FILE_SIZE - SKIP);
+}
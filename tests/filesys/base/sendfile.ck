@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sendfile) begin
+(sendfile) create "src"
+(sendfile) open "src"
+(sendfile) write "src"
+(sendfile) create "dst"
+(sendfile) open "dst"
+(sendfile) sendfile "src" to "dst"
+(sendfile) tell "src"
+(sendfile) tell "dst"
+(sendfile) close "src"
+(sendfile) close "dst"
+(sendfile) open "dst" for verification
+(sendfile) verified contents of "dst"
+(sendfile) close "dst"
+(sendfile) end
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Spawns several child processes that each write and read back a
+   file of their own at the same time, then checks that every
+   file ended up with the right contents.  No two children touch
+   the same file, so none of them should have to wait for
+   another. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/base/syn-indep.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+char buf1[BUF_SIZE];
+char buf2[BUF_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  int i;
+
+  exec_children ("child-syn-indep", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+
+  for (i = 0; i < CHILD_CNT; i++) 
+    {
+      char file_name[16];
+      int fd;
+
+      snprintf (file_name, sizeof file_name, "indep%d", i);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      CHECK (read (fd, buf1, sizeof buf1) == sizeof buf1,
+             "read \"%s\"", file_name);
+      random_init (i);
+      random_bytes (buf2, sizeof buf2);
+      compare_bytes (buf1, buf2, sizeof buf1, 0, file_name);
+      msg ("close \"%s\"", file_name);
+      close (fd);
+    }
+}
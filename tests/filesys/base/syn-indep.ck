@@ -0,0 +1,39 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-indep) begin
+(syn-indep) exec child 1 of 6: "child-syn-indep 0"
+(syn-indep) exec child 2 of 6: "child-syn-indep 1"
+(syn-indep) exec child 3 of 6: "child-syn-indep 2"
+(syn-indep) exec child 4 of 6: "child-syn-indep 3"
+(syn-indep) exec child 5 of 6: "child-syn-indep 4"
+(syn-indep) exec child 6 of 6: "child-syn-indep 5"
+(syn-indep) wait for child 1 of 6 returned 0 (expected 0)
+(syn-indep) wait for child 2 of 6 returned 1 (expected 1)
+(syn-indep) wait for child 3 of 6 returned 2 (expected 2)
+(syn-indep) wait for child 4 of 6 returned 3 (expected 3)
+(syn-indep) wait for child 5 of 6 returned 4 (expected 4)
+(syn-indep) wait for child 6 of 6 returned 5 (expected 5)
+(syn-indep) open "indep0"
+(syn-indep) read "indep0"
+(syn-indep) close "indep0"
+(syn-indep) open "indep1"
+(syn-indep) read "indep1"
+(syn-indep) close "indep1"
+(syn-indep) open "indep2"
+(syn-indep) read "indep2"
+(syn-indep) close "indep2"
+(syn-indep) open "indep3"
+(syn-indep) read "indep3"
+(syn-indep) close "indep3"
+(syn-indep) open "indep4"
+(syn-indep) read "indep4"
+(syn-indep) close "indep4"
+(syn-indep) open "indep5"
+(syn-indep) read "indep5"
+(syn-indep) close "indep5"
+(syn-indep) end
+EOF
+pass;
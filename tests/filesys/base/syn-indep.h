@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_BASE_SYN_INDEP_H
+#define TESTS_FILESYS_BASE_SYN_INDEP_H
+
+#define CHILD_CNT 6
+#define CHUNK_SIZE 1024
+#define CHUNK_CNT 8
+#define BUF_SIZE (CHUNK_CNT * CHUNK_SIZE)
+
+#endif /* tests/filesys/base/syn-indep.h */
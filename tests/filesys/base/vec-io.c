@@ -0,0 +1,62 @@
+/* Writes a file with writev(), overwrites part of it with
+   pwrite(), and reads it back with pread() and readv(), checking
+   the data and that only the vectored calls move the file
+   position. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PART_SIZE 700
+
+static char part1[PART_SIZE];
+static char part2[PART_SIZE];
+static char part3[PART_SIZE];
+static char patch[100];
+static char expected[3 * PART_SIZE];
+static char buf1[PART_SIZE + 300];
+static char buf2[2 * PART_SIZE - 300];
+
+void
+test_main (void) 
+{
+  struct iovec out[] = {{part1, PART_SIZE}, {part2, PART_SIZE},
+                        {part3, PART_SIZE}};
+  struct iovec in[] = {{buf1, sizeof buf1}, {buf2, sizeof buf2}};
+  int fd;
+
+  memset (part1, 'a', PART_SIZE);
+  memset (part2, 'b', PART_SIZE);
+  memset (part3, 'c', PART_SIZE);
+  memset (patch, 'p', sizeof patch);
+
+  CHECK (create ("vec", 0), "create \"vec\"");
+  CHECK ((fd = open ("vec")) > 1, "open \"vec\"");
+  CHECK (writev (fd, out, 3) == 3 * PART_SIZE, "writev \"vec\"");
+  CHECK (tell (fd) == 3 * PART_SIZE, "tell \"vec\" after writev");
+
+  CHECK (pwrite (fd, patch, sizeof patch, PART_SIZE - 50) == sizeof patch,
+         "pwrite \"vec\"");
+  CHECK (tell (fd) == 3 * PART_SIZE, "tell \"vec\" after pwrite");
+
+  memcpy (expected, part1, PART_SIZE);
+  memcpy (expected + PART_SIZE, part2, PART_SIZE);
+  memcpy (expected + 2 * PART_SIZE, part3, PART_SIZE);
+  memcpy (expected + PART_SIZE - 50, patch, sizeof patch);
+
+  CHECK (pread (fd, buf1, 200, PART_SIZE - 100) == 200, "pread \"vec\"");
+  compare_bytes (buf1, expected + PART_SIZE - 100, 200, PART_SIZE - 100,
+                 "vec");
+  CHECK (tell (fd) == 3 * PART_SIZE, "tell \"vec\" after pread");
+
+  seek (fd, 0);
+  CHECK (readv (fd, in, 2) == 3 * PART_SIZE, "readv \"vec\"");
+  compare_bytes (buf1, expected, sizeof buf1, 0, "vec");
+  compare_bytes (buf2, expected + sizeof buf1, sizeof buf2, sizeof buf1,
+                 "vec");
+  CHECK (tell (fd) == 3 * PART_SIZE, "tell \"vec\" after readv");
+
+  msg ("close \"vec\"");
+  close (fd);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(vec-io) begin
+(vec-io) create "vec"
+(vec-io) open "vec"
+(vec-io) writev "vec"
+(vec-io) tell "vec" after writev
+(vec-io) pwrite "vec"
+(vec-io) tell "vec" after pwrite
+(vec-io) pread "vec"
+(vec-io) tell "vec" after pread
+(vec-io) readv "vec"
+(vec-io) tell "vec" after readv
+(vec-io) close "vec"
+(vec-io) end
+EOF
+pass;
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "File system extraction run did not replay the journal.\n"
+  if !grep (/^Replaying journal: \d+ sectors...done\.$/, @output);
+check_archive ({"replay" => [random_bytes (10000)]});
+pass;
@@ -0,0 +1,25 @@
+/* Writes a file with the kernel booted with -journal-crash, which
+   leaves the last journal commit unfinished at power off, as if the
+   machine had crashed right after making it.  The file system is
+   then only whole, and the file only there, if the next mount
+   replays the journal. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[10000];
+
+void
+test_main (void) 
+{
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("replay", 0), "create \"replay\"");
+  CHECK ((fd = open ("replay")) > 1, "open \"replay\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"replay\"");
+  msg ("close \"replay\"");
+  close (fd);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-replay) begin
+(journal-replay) create "replay"
+(journal-replay) open "replay"
+(journal-replay) write "replay"
+(journal-replay) close "replay"
+(journal-replay) end
+EOF
+pass;
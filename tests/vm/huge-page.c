@@ -0,0 +1,41 @@
+/* Checks that a 2 MB-aligned anonymous region is backed by one
+   physically contiguous huge page on first touch, and that
+   releasing one of its pages splits it without disturbing the
+   rest. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HUGE_SIZE (2 * 1024 * 1024)
+#define HUGE_PAGES (HUGE_SIZE / PAGE_SIZE)
+
+static char buf[HUGE_SIZE] __attribute__ ((aligned (HUGE_SIZE)));
+
+void
+test_main (void)
+{
+	uintptr_t pa;
+	size_t i;
+
+	buf[0] = 1;
+	pa = (uintptr_t) get_phys_addr (buf);
+	CHECK (pa % HUGE_SIZE == 0, "first touch maps an aligned huge page");
+	for (i = 1; i < HUGE_PAGES; i++)
+		if ((uintptr_t) get_phys_addr (&buf[i * PAGE_SIZE]) != pa + i * PAGE_SIZE)
+			fail ("page %zu is not part of the huge page", i);
+	msg ("whole region is contiguous");
+
+	for (i = 0; i < HUGE_PAGES; i++)
+		buf[i * PAGE_SIZE] = i % 128;
+	CHECK (madvise (&buf[7 * PAGE_SIZE], PAGE_SIZE, MADV_DONTNEED) == 0,
+	       "release one page");
+	CHECK (get_phys_addr (&buf[7 * PAGE_SIZE]) == 0, "released page is gone");
+	for (i = 0; i < HUGE_PAGES; i++)
+		if (i != 7 && buf[i * PAGE_SIZE] != (char) (i % 128))
+			fail ("page %zu lost its contents after split", i);
+	CHECK (buf[7 * PAGE_SIZE] == 0, "released page reads as zeros");
+}
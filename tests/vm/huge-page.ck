@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(huge-page) begin
+(huge-page) first touch maps an aligned huge page
+(huge-page) whole region is contiguous
+(huge-page) release one page
+(huge-page) released page is gone
+(huge-page) released page reads as zeros
+(huge-page) end
+EOF
+pass;
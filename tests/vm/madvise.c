@@ -0,0 +1,69 @@
+/* Checks that madvise() and mlock() act on the residency of a range:
+   MADV_WILLNEED faults pages in, MADV_DONTNEED drops them so they
+   come back zeroed, and mlock()'d pages refuse MADV_DONTNEED. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define CHUNK_PAGE_COUNT 4
+#define CHUNK_SIZE (CHUNK_PAGE_COUNT * PAGE_SIZE)
+
+static char buf[CHUNK_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+static bool
+all_loaded (void)
+{
+	size_t i;
+
+	for (i = 0; i < CHUNK_PAGE_COUNT; i++)
+		if (get_phys_addr (&buf[i * PAGE_SIZE]) == 0)
+			return false;
+	return true;
+}
+
+static bool
+none_loaded (void)
+{
+	size_t i;
+
+	for (i = 0; i < CHUNK_PAGE_COUNT; i++)
+		if (get_phys_addr (&buf[i * PAGE_SIZE]) != 0)
+			return false;
+	return true;
+}
+
+void
+test_main (void)
+{
+	size_t i;
+
+	CHECK (madvise (buf + 1, PAGE_SIZE, MADV_NORMAL) == -1,
+	       "madvise on misaligned address must fail");
+	CHECK (madvise (buf, CHUNK_SIZE, 42) == -1,
+	       "madvise with unknown advice must fail");
+
+	CHECK (madvise (buf, CHUNK_SIZE, MADV_WILLNEED) == 0, "madvise WILLNEED");
+	CHECK (all_loaded (), "check if pages are loaded");
+
+	for (i = 0; i < CHUNK_PAGE_COUNT; i++)
+		buf[i * PAGE_SIZE] = 'a' + i;
+	CHECK (madvise (buf, CHUNK_SIZE, MADV_DONTNEED) == 0, "madvise DONTNEED");
+	CHECK (none_loaded (), "check if pages are released");
+	for (i = 0; i < CHUNK_PAGE_COUNT; i++)
+		if (buf[i * PAGE_SIZE] != 0)
+			fail ("page %zu not zeroed after MADV_DONTNEED", i);
+
+	CHECK (mlock (buf, CHUNK_SIZE) == 0, "mlock");
+	CHECK (all_loaded (), "check if locked pages are loaded");
+	CHECK (madvise (buf, CHUNK_SIZE, MADV_DONTNEED) == -1,
+	       "madvise DONTNEED on locked pages must fail");
+	CHECK (munlock (buf, CHUNK_SIZE) == 0, "munlock");
+	CHECK (madvise (buf, CHUNK_SIZE, MADV_DONTNEED) == 0,
+	       "madvise DONTNEED after munlock");
+	CHECK (none_loaded (), "check if pages are released");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) madvise on misaligned address must fail
+(madvise) madvise with unknown advice must fail
+(madvise) madvise WILLNEED
+(madvise) check if pages are loaded
+(madvise) madvise DONTNEED
+(madvise) check if pages are released
+(madvise) mlock
+(madvise) check if locked pages are loaded
+(madvise) madvise DONTNEED on locked pages must fail
+(madvise) munlock
+(madvise) madvise DONTNEED after munlock
+(madvise) check if pages are released
+(madvise) end
+EOF
+pass;
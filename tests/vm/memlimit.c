@@ -0,0 +1,42 @@
+/* Puts a resident limit on the process, then touches many more
+   pages than it allows.  The process must stay within its limit by
+   swapping out its own pages, and must get every page back intact. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+#define LIMIT 16
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+void
+test_main (void)
+{
+	struct memstat st;
+	size_t i;
+
+	CHECK (memstat (&st) == 0, "memstat");
+	CHECK (st.resident > 0 && st.resident_limit == 0, "no limit at start");
+
+	CHECK (memlimit (LIMIT) == 0, "memlimit %d pages", LIMIT);
+	for (i = 0; i < PAGE_CNT; i++) {
+		buf[i * PAGE_SIZE] = i;
+		memstat (&st);
+		if (st.resident > LIMIT)
+			fail ("%zu pages resident, limit is %d", st.resident, LIMIT);
+	}
+	memstat (&st);
+	CHECK (st.swapped > 0, "own pages were swapped out");
+
+	for (i = 0; i < PAGE_CNT; i++)
+		if (buf[i * PAGE_SIZE] != (char) i)
+			fail ("page %zu has bad contents", i);
+	msg ("all pages intact");
+
+	CHECK (memlimit (0) == 0, "remove limit");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(memlimit) begin
+(memlimit) memstat
+(memlimit) no limit at start
+(memlimit) memlimit 16 pages
+(memlimit) own pages were swapped out
+(memlimit) all pages intact
+(memlimit) remove limit
+(memlimit) end
+EOF
+pass;
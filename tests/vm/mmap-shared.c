@@ -0,0 +1,49 @@
+/* Maps the same file twice and checks that both mappings and the
+   read and write system calls all see one copy of the data. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MAP1 ((char *) 0x10000000)
+#define MAP2 ((char *) 0x20000000)
+
+void
+test_main (void)
+{
+  int handle;
+  char buf[1024];
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (MAP1, 4096, 1, handle, 0) != MAP_FAILED, "mmap \"sample.txt\" twice");
+  CHECK (mmap (MAP2, 4096, 1, handle, 0) != MAP_FAILED, "mmap \"sample.txt\" again");
+
+  /* A store through one mapping shows up in the other. */
+  memcpy (MAP1, "shared", 6);
+  CHECK (!memcmp (MAP2, "shared", 6), "second mapping sees store");
+
+  /* read() sees the mapped data before it is written back. */
+  seek (handle, 0);
+  CHECK (read (handle, buf, 6) == 6, "read mapped file");
+  CHECK (!memcmp (buf, "shared", 6), "read sees store");
+
+  /* write() is visible through both mappings. */
+  seek (handle, 0);
+  CHECK (write (handle, "SHARED", 6) == 6, "write mapped file");
+  CHECK (!memcmp (MAP1, "SHARED", 6) && !memcmp (MAP2, "SHARED", 6),
+         "mappings see write");
+
+  munmap (MAP1);
+  munmap (MAP2);
+
+  /* The file holds the final contents. */
+  seek (handle, 0);
+  CHECK (read (handle, buf, strlen (sample)) == (int) strlen (sample),
+         "read after munmap");
+  CHECK (!memcmp (buf, "SHARED", 6)
+         && !memcmp (buf + 6, sample + 6, strlen (sample) - 6),
+         "file holds written data");
+  close (handle);
+}
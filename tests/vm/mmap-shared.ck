@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-shared) begin
+(mmap-shared) open "sample.txt"
+(mmap-shared) mmap "sample.txt" twice
+(mmap-shared) mmap "sample.txt" again
+(mmap-shared) second mapping sees store
+(mmap-shared) read mapped file
+(mmap-shared) read sees store
+(mmap-shared) write mapped file
+(mmap-shared) mappings see write
+(mmap-shared) read after munmap
+(mmap-shared) file holds written data
+(mmap-shared) end
+EOF
+pass;
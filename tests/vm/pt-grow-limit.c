@@ -0,0 +1,42 @@
+/* Grows the stack a page at a time to 900 kB, checking that every
+   page keeps its contents, then touches a stack object that reaches
+   past the 1 MB stack limit.  The process must be terminated with -1
+   exit code. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DEPTH (900 * 1024)
+
+static void __attribute__ ((noinline))
+grow (void)
+{
+  volatile char stk[DEPTH];
+  size_t i;
+
+  for (i = DEPTH; i >= 4096; i -= 4096)
+    stk[i - 1] = i / 4096;
+  for (i = DEPTH; i >= 4096; i -= 4096)
+    if (stk[i - 1] != (char) (i / 4096))
+      fail ("stack page %zu bytes down lost its contents", DEPTH - i);
+}
+
+static int __attribute__ ((noinline))
+overflow (void)
+{
+  volatile char stk[1100 * 1024];
+
+  stk[0] = 1;
+  return stk[0];
+}
+
+void
+test_main (void)
+{
+  grow ();
+  msg ("grew stack to 900 kB");
+  msg ("touch past the stack limit");
+  overflow ();
+  fail ("should have exited with -1");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(pt-grow-limit) begin
+(pt-grow-limit) grew stack to 900 kB
+(pt-grow-limit) touch past the stack limit
+pt-grow-limit: exit(-1)
+EOF
+pass;
@@ -36,6 +36,10 @@
 #include "devices/disk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/journal.h"
+#endif
+#ifdef EFILESYS
+#include "filesys/fat.h"
 #endif
 
 /* Page-map-level-4 with kernel mappings only. */
@@ -216,6 +220,17 @@ parse_options (char **argv) {
 #ifdef FILESYS
 		else if (!strcmp (name, "-f"))
 			format_filesys = true;
+		else if (!strcmp (name, "-journal-crash"))
+			journal_crash = true;
+#endif
+#ifdef EFILESYS
+		else if (!strcmp (name, "-cluster")) {
+			int sectors = atoi (value);
+			if (sectors < 1 || sectors > FAT_MAX_CLUSTER_SECTORS)
+				PANIC ("-cluster must be 1 to %d sectors",
+						FAT_MAX_CLUSTER_SECTORS);
+			fat_cluster_sectors = sectors;
+		}
 #endif
 		else if (!strcmp (name, "-rs"))
 			random_init (atoi (value));
@@ -226,6 +241,10 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-stack"))
+			vm_stack_limit = (size_t) atoi (value) * 1024;
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -324,10 +343,17 @@ usage (void) {
 			"  -h                 Print this help message and power off.\n"
 			"  -q                 Power off VM after actions or on panic.\n"
 			"  -f                 Format file system disk during startup.\n"
+			"  -journal-crash     Leave the last commit in the journal at power off.\n"
+#ifdef EFILESYS
+			"  -cluster=N         Format with N-sector clusters (1 to 64).\n"
+#endif
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -stack=KB          Limit user stacks to KB kB (default 1024).\n"
 #endif
 			);
 	power_off ();
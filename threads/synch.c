@@ -375,4 +375,72 @@ void cond_broadcast(struct condition *cond, struct lock *lock)
 
     while (!list_empty(&cond->waiters))
         cond_signal(cond, lock);
-}
\ No newline at end of file
+}
+
+/* Initializes RW, a readers-writer lock.  Any number of readers
+   may hold RW at once, or a single writer.  A waiting writer keeps
+   new readers out, so that a steady stream of readers cannot
+   starve it. */
+void rwlock_init(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+
+    lock_init(&rw->lock);
+    cond_init(&rw->cond);
+    rw->readers = 0;
+    rw->writer = false;
+    rw->waiting_writers = 0;
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it. */
+void rwlock_acquire_read(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+    ASSERT(!intr_context());
+
+    lock_acquire(&rw->lock);
+    while (rw->writer || rw->waiting_writers > 0)
+        cond_wait(&rw->cond, &rw->lock);
+    rw->readers++;
+    lock_release(&rw->lock);
+}
+
+/* Releases RW, held for reading. */
+void rwlock_release_read(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+
+    lock_acquire(&rw->lock);
+    ASSERT(rw->readers > 0);
+    if (--rw->readers == 0)
+        cond_broadcast(&rw->cond, &rw->lock);
+    lock_release(&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until no one else holds it. */
+void rwlock_acquire_write(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+    ASSERT(!intr_context());
+
+    lock_acquire(&rw->lock);
+    rw->waiting_writers++;
+    while (rw->writer || rw->readers > 0)
+        cond_wait(&rw->cond, &rw->lock);
+    rw->waiting_writers--;
+    rw->writer = true;
+    lock_release(&rw->lock);
+}
+
+/* Releases RW, held for writing. */
+void rwlock_release_write(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+
+    lock_acquire(&rw->lock);
+    ASSERT(rw->writer);
+    rw->writer = false;
+    cond_broadcast(&rw->cond, &rw->lock);
+    lock_release(&rw->lock);
+}
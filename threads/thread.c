@@ -11,6 +11,10 @@
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
+#ifdef FILESYS
+#include "devices/disk.h"
+#include "threads/malloc.h"
+#endif
 
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -198,6 +202,11 @@ tid_t thread_create(const char *name, int priority,
     t->fdt = palloc_get_multiple(PAL_ZERO, FDT_PAGES);
     if (t->fdt == NULL)
         return TID_ERROR;
+#ifdef FILESYS
+    t->sector_buf = malloc(DISK_SECTOR_SIZE);
+    if (t->sector_buf == NULL)
+        return TID_ERROR;
+#endif
 
     t->exit_status = 0;
 
@@ -10,9 +10,12 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -204,6 +207,9 @@ __do_fork(void *aux)
         current->fdt[i] = file;
     }
     current->next_fd = parent->next_fd;
+    // 자식도 부모의 실행 파일을 열어 둔다. (lazy loading 시 이 파일에서 읽는다.)
+    if (parent->running != NULL)
+        current->running = file_duplicate(parent->running);
 
     // 로드가 완료될 때까지 기다리고 있던 부모 대기 해제
     sema_up(&current->load_sema);
@@ -253,7 +259,12 @@ int process_exec(void *f_name)
         return -1;
     }
 
-    argument_stack(arg_list, arg_cnt, &_if.rsp); // 함수 내부에서 parse와 rsp의 값을 직접 변경하기 위해 주소 전달
+    // 함수 내부에서 parse와 rsp의 값을 직접 변경하기 위해 주소 전달
+    if (!argument_stack(arg_list, arg_cnt, &_if.rsp))
+    {
+        palloc_free_page(file_name);
+        return -1;
+    }
     _if.R.rdi = arg_cnt;
     _if.R.rsi = (char *)_if.rsp + 8;
 
@@ -307,6 +318,9 @@ void process_exit(void)
      * TODO: project2/process_termination.html).
      * TODO: We recommend you to implement process resource cleanup here. */
 
+    // 시스템 콜 도중에 종료되었다면 열려 있는 저널 핸들을 닫는다.
+    journal_release();
+
     // FDT의 모든 파일을 닫고 메모리를 반환한다.
     for (int i = 2; i < FDT_COUNT_LIMIT; i++)
     {
@@ -314,6 +328,7 @@ void process_exit(void)
             close(i);
     }
     palloc_free_multiple(curr->fdt, FDT_PAGES);
+    free(curr->sector_buf);
 
     file_close(curr->running); // 현재 실행 중인 파일도 닫는다.
     process_cleanup();
@@ -364,8 +379,23 @@ void process_activate(struct thread *next)
     tss_update(next);
 }
 
-void argument_stack(char **parse, int count, void **rsp) // 주소를 전달받았으므로 이중 포인터 사용
+bool argument_stack(char **parse, int count, void **rsp) // 주소를 전달받았으므로 이중 포인터 사용
 {
+    // 인자들이 스택에서 차지할 크기: 문자열, 패딩(최대 7), argv[] + NULL, return address
+    size_t size = 7 + (count + 2) * sizeof(char *);
+    for (int i = 0; i < count; i++)
+        size += strlen(parse[i]) + 1;
+
+#ifdef VM
+    // 인자와 프로그램의 첫 스택 프레임들이 들어갈 페이지를 미리 할당하고 올려둔다.
+    if (!vm_stack_prefault(size + PGSIZE))
+        return false;
+#else
+    // 스택은 setup_stack에서 매핑한 한 페이지뿐이다.
+    if (size > PGSIZE)
+        return false;
+#endif
+
     // 프로그램 이름, 인자 문자열 push
     for (int i = count - 1; i > -1; i--)
     {
@@ -399,6 +429,60 @@ void argument_stack(char **parse, int count, void **rsp) // 주소를 전달받
     // return address push
     (*rsp) -= 8;
     **(void ***)rsp = 0;
+    return true;
+}
+
+/* 파일 객체에 대한 파일 디스크립터를 생성하는 함수 */
+int process_add_file(struct file *f)
+{
+    struct thread *curr = thread_current();
+    struct file **fdt = curr->fdt;
+
+    /* limit을 넘지 않는 범위 안에서 빈 자리 탐색 */
+    while (curr->next_fd < FDT_COUNT_LIMIT && fdt[curr->next_fd])
+        curr->next_fd++;
+    if (curr->next_fd >= FDT_COUNT_LIMIT)
+        return -1;
+    fdt[curr->next_fd] = f;
+
+    return curr->next_fd;
+}
+
+/* 파일 객체를 검색하는 함수 */
+struct file *process_get_file(int fd)
+{
+    struct thread *curr = thread_current();
+    struct file **fdt = curr->fdt;
+    /* 파일 디스크립터에 해당하는 파일 객체를 리턴 */
+    /* 없을 시 NULL 리턴 */
+    if (fd < 2 || fd >= FDT_COUNT_LIMIT)
+        return NULL;
+    return fdt[fd];
+}
+
+/* 파일 디스크립터 테이블에서 파일 객체를 제거하는 함수 */
+void process_close_file(int fd)
+{
+    struct thread *curr = thread_current();
+    struct file **fdt = curr->fdt;
+    if (fd < 2 || fd >= FDT_COUNT_LIMIT)
+        return NULL;
+    fdt[fd] = NULL;
+}
+
+// 자식 리스트에서 원하는 프로세스를 검색하는 함수
+struct thread *get_child_process(int pid)
+{
+    /* 자식 리스트에 접근하여 프로세스 디스크립터 검색 */
+    struct thread *cur = thread_current();
+    struct list *child_list = &cur->child_list;
+    for (struct list_elem *e = list_begin(child_list); e != list_end(child_list); e = list_next(e))
+    {
+        struct thread *t = list_entry(e, struct thread, child_elem);
+        if (t->tid == pid)
+            return t;
+    }
+    return NULL;
 }
 
 /* We load ELF binaries.  The following definitions are taken
@@ -732,59 +816,6 @@ install_page(void *upage, void *kpage, bool writable)
     return (pml4_get_page(t->pml4, upage) == NULL && pml4_set_page(t->pml4, upage, kpage, writable));
 }
 
-/* 파일 객체에 대한 파일 디스크립터를 생성하는 함수 */
-int process_add_file(struct file *f)
-{
-    struct thread *curr = thread_current();
-    struct file **fdt = curr->fdt;
-
-    /* limit을 넘지 않는 범위 안에서 빈 자리 탐색 */
-    while (curr->next_fd < FDT_COUNT_LIMIT && fdt[curr->next_fd])
-        curr->next_fd++;
-    if (curr->next_fd >= FDT_COUNT_LIMIT)
-        return -1;
-    fdt[curr->next_fd] = f;
-
-    return curr->next_fd;
-}
-
-/* 파일 객체를 검색하는 함수 */
-struct file *process_get_file(int fd)
-{
-    struct thread *curr = thread_current();
-    struct file **fdt = curr->fdt;
-    /* 파일 디스크립터에 해당하는 파일 객체를 리턴 */
-    /* 없을 시 NULL 리턴 */
-    if (fd < 2 || fd >= FDT_COUNT_LIMIT)
-        return NULL;
-    return fdt[fd];
-}
-
-/* 파일 디스크립터 테이블에서 파일 객체를 제거하는 함수 */
-void process_close_file(int fd)
-{
-    struct thread *curr = thread_current();
-    struct file **fdt = curr->fdt;
-    if (fd < 2 || fd >= FDT_COUNT_LIMIT)
-        return NULL;
-    fdt[fd] = NULL;
-}
-
-// 자식 리스트에서 원하는 프로세스를 검색하는 함수
-struct thread *get_child_process(int pid)
-{
-    /* 자식 리스트에 접근하여 프로세스 디스크립터 검색 */
-    struct thread *cur = thread_current();
-    struct list *child_list = &cur->child_list;
-    for (struct list_elem *e = list_begin(child_list); e != list_end(child_list); e = list_next(e))
-    {
-        struct thread *t = list_entry(e, struct thread, child_elem);
-        if (t->tid == pid)
-            return t;
-    }
-    return NULL;
-}
-
 #else
 /* From here, codes will be used after project 3.
  * If you want to implement the function for only project 2, implement it on the
@@ -796,6 +827,21 @@ lazy_load_segment(struct page *page, void *aux)
 	/* TODO: Load the segment from the file */
 	/* TODO: This called when the first page fault occurs on address VA. */
 	/* TODO: VA is available when calling this function. */
+	struct lazy_load_info *info = aux;
+	struct file *file = info->file != NULL ? info->file : thread_current()->running;
+	uint8_t *kva = vm_page_kva(page);
+	bool success = true;
+
+	/* Straight from the inode, without the file's rw lock: the fault
+	 * may come from a system call with a journal handle open, which
+	 * must not wait for one.  No one writes an executable while it
+	 * runs anyway. */
+	if (inode_read_at(file_get_inode(file), kva, info->read_bytes, info->ofs) != (int)info->read_bytes)
+		success = false;
+	else
+		memset(kva + info->read_bytes, 0, info->zero_bytes);
+	free(info);
+	return success;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -813,7 +859,7 @@ lazy_load_segment(struct page *page, void *aux)
  * Return true if successful, false if a memory allocation error
  * or disk read error occurs. */
 static bool
-load_segment(struct file *file, off_t ofs, uint8_t *upage,
+load_segment(struct file *file UNUSED, off_t ofs, uint8_t *upage,
 			 uint32_t read_bytes, uint32_t zero_bytes, bool writable)
 {
 	ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
@@ -829,15 +875,30 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
 		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer(VM_ANON, upage,
+		/* The executable is reached through thread->running, which
+		 * fork() duplicates, so FILE itself is not recorded here. */
+		struct lazy_load_info *aux = malloc(sizeof *aux);
+		if (aux == NULL)
+			return false;
+		aux->file = NULL;
+		aux->ofs = ofs;
+		aux->read_bytes = page_read_bytes;
+		aux->zero_bytes = page_zero_bytes;
+		/* A page with nothing to read, such as one of the BSS, starts
+		 * out zeroed like a stack page and is marked the same way. */
+		enum vm_type type = page_read_bytes == 0 ? VM_ANON | VM_MARKER_0 : VM_ANON;
+		if (!vm_alloc_page_with_initializer(type, upage,
 											writable, lazy_load_segment, aux))
+		{
+			free(aux);
 			return false;
+		}
 
 		/* Advance. */
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
+		ofs += page_read_bytes;
 	}
 	return true;
 }
@@ -853,6 +914,11 @@ setup_stack(struct intr_frame *if_)
 	 * TODO: If success, set the rsp accordingly.
 	 * TODO: You should mark the page is stack. */
 	/* TODO: Your code goes here */
+	if (vm_stack_prefault(USER_STACK - (uintptr_t)stack_bottom))
+	{
+		if_->rsp = USER_STACK;
+		success = true;
+	}
 
 	return success;
 }
@@ -1,5 +1,7 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
@@ -9,17 +11,23 @@
 #include "threads/flags.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
 #include "intrinsic.h"
 #include "threads/synch.h"
 #include "devices/input.h"
 #include "lib/kernel/stdio.h"
 #include "threads/palloc.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
 
-struct lock filesys_lock;
 typedef int pid_t;
 void syscall_entry(void);
 void syscall_handler(struct intr_frame *);
 void check_address(void *uaddr);
+static void check_buffer(const void *buffer, size_t size, bool writable);
+static void check_string(const char *str);
 void exit(int status);
 
 void halt(void);
@@ -32,9 +40,28 @@ unsigned tell(int fd);
 void close(int fd);
 int read(int fd, void *buffer, unsigned size);
 int write(int fd, const void *buffer, unsigned size);
+int pread(int fd, void *buffer, unsigned size, off_t offset);
+int pwrite(int fd, const void *buffer, unsigned size, off_t offset);
+int readv(int fd, const struct file_vec *iov, int iovcnt);
+int writev(int fd, const struct file_vec *iov, int iovcnt);
+int sendfile(int out_fd, int in_fd, unsigned size);
+int fsync(int fd);
+int fdatasync(int fd);
+void sync(void);
+int fallocate(int fd, int mode, off_t offset, off_t len);
+int getdents(int fd, struct dir_record *entries, int cnt);
 pid_t fork(const char *thread_name);
 int exec(const char *file);
 int wait(int pid);
+#ifdef VM
+void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
+void munmap(void *addr);
+int madvise(void *addr, size_t length, int advice);
+int mlock(const void *addr, size_t length);
+int munlock(const void *addr, size_t length);
+int memstat(struct vm_usage *usage);
+int memlimit(size_t pages);
+#endif
 
 /* System call.
  *
@@ -60,7 +87,6 @@ void syscall_init(void)
      * mode stack. Therefore, we masked the FLAG_FL. */
     write_msr(MSR_SYSCALL_MASK,
               FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
-    lock_init(&filesys_lock);
 }
 
 /* The main system call interface */
@@ -68,6 +94,10 @@ void syscall_handler(struct intr_frame *f UNUSED)
 {
     // TODO: Your implementation goes here.
     int syscall_number = f->R.rax; // 원하는 기능에 해당하는 시스템 콜 번호
+#ifdef VM
+    // 커널 안에서 사용자 스택에 page fault가 나면 f->rsp는 커널 스택이므로 사용자 rsp를 저장해둔다.
+    thread_current()->user_rsp = f->rsp;
+#endif
     switch (syscall_number)
     {
         case SYS_HALT:
@@ -113,6 +143,59 @@ void syscall_handler(struct intr_frame *f UNUSED)
         case SYS_CLOSE:
             close(f->R.rdi);
             break;
+        case SYS_PREAD:
+            f->R.rax = pread(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10);
+            break;
+        case SYS_PWRITE:
+            f->R.rax = pwrite(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10);
+            break;
+        case SYS_READV:
+            f->R.rax = readv(f->R.rdi, f->R.rsi, f->R.rdx);
+            break;
+        case SYS_WRITEV:
+            f->R.rax = writev(f->R.rdi, f->R.rsi, f->R.rdx);
+            break;
+        case SYS_SENDFILE:
+            f->R.rax = sendfile(f->R.rdi, f->R.rsi, f->R.rdx);
+            break;
+        case SYS_FSYNC:
+            f->R.rax = fsync(f->R.rdi);
+            break;
+        case SYS_FDATASYNC:
+            f->R.rax = fdatasync(f->R.rdi);
+            break;
+        case SYS_SYNC:
+            sync();
+            break;
+        case SYS_FALLOCATE:
+            f->R.rax = fallocate(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10);
+            break;
+        case SYS_GETDENTS:
+            f->R.rax = getdents(f->R.rdi, f->R.rsi, f->R.rdx);
+            break;
+#ifdef VM
+        case SYS_MMAP:
+            f->R.rax = mmap(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10, f->R.r8);
+            break;
+        case SYS_MUNMAP:
+            munmap(f->R.rdi);
+            break;
+        case SYS_MADVISE:
+            f->R.rax = madvise(f->R.rdi, f->R.rsi, f->R.rdx);
+            break;
+        case SYS_MLOCK:
+            f->R.rax = mlock(f->R.rdi, f->R.rsi);
+            break;
+        case SYS_MUNLOCK:
+            f->R.rax = munlock(f->R.rdi, f->R.rsi);
+            break;
+        case SYS_MEMSTAT:
+            f->R.rax = memstat(f->R.rdi);
+            break;
+        case SYS_MEMLIMIT:
+            f->R.rax = memlimit(f->R.rdi);
+            break;
+#endif
         default:
             exit(-1);
             break;
@@ -124,12 +207,79 @@ void syscall_handler(struct intr_frame *f UNUSED)
 void check_address(void *uaddr)
 {
     struct thread *cur = thread_current();
+#ifdef VM
+    // lazy loading 때문에 아직 매핑되지 않은 페이지도 spt에 있으면 유효하다.
+    // 아직 자라지 않은 스택 영역도 접근 시 page fault로 확장되므로 유효하다.
+    if (uaddr == NULL || is_kernel_vaddr(uaddr)
+        || (spt_find_page(&cur->spt, uaddr) == NULL && !vm_is_stack_access(uaddr, cur->user_rsp)))
+#else
     if (uaddr == NULL || is_kernel_vaddr(uaddr) || pml4_get_page(cur->pml4, uaddr) == NULL)
+#endif
     {
         exit(-1);
     }
 }
 
+/* buffer부터 size 바이트가 모두 사용자 메모리인지 페이지마다 검사하고,
+   writable이면 모두 쓸 수 있는지도 검사한다. 아니면 프로세스를 끝낸다.
+   파일 시스템은 잠금을 잡은 채 사용자 메모리를 읽고 쓰므로, 그 도중에
+   잘못된 주소로 page fault가 나서 잠금을 쥔 채 종료되는 일이 없도록
+   잠금을 잡기 전에 버퍼 전체를 검사해야 한다. */
+static void check_buffer(const void *buffer, size_t size, bool writable)
+{
+    struct thread *cur = thread_current();
+    uint8_t *start = pg_round_down(buffer);
+    uint8_t *last = (uint8_t *)buffer + size - 1;
+
+    if (size == 0)
+        return;
+    if (last < (uint8_t *)buffer)
+        exit(-1);
+    for (uint8_t *va = start; va <= last; va += PGSIZE)
+    {
+        check_address(va == start ? (void *)buffer : va);
+        if (!writable)
+            continue;
+#ifdef VM
+        // spt에 없으면 check_address가 통과시킨 스택 영역이고, 스택은 쓸 수 있다.
+        struct page *page = spt_find_page(&cur->spt, va);
+        if (page != NULL && !page->writable)
+            exit(-1);
+#else
+        uint64_t *pte = pml4e_walk(cur->pml4, (uint64_t)va, 0);
+        if (pte == NULL || !is_writable(pte))
+            exit(-1);
+#endif
+    }
+}
+
+/* str이 가리키는 문자열 전체가 NULL 문자까지 사용자 메모리인지 검사한다.
+   페이지 경계를 넘을 때마다 다음 페이지를 검사한다. */
+static void check_string(const char *str)
+{
+    check_address((void *)str);
+    for (const char *p = str; *p != '\0'; p++)
+        if (pg_ofs(p + 1) == 0)
+            check_address((void *)(p + 1));
+}
+
+/* file이 디렉터리인지 확인한다. 이 파일 시스템의 디렉터리는 open("/")로
+   여는 루트 디렉터리 하나뿐이다. */
+static bool is_dir(struct file *file)
+{
+    return inode_get_inumber(file_get_inode(file)) == ROOT_DIR_SECTOR;
+}
+
+/* fd로 열린 일반 파일을 돌려준다. 디렉터리는 바이트 단위로 읽고 쓰면
+   안 되므로 디렉터리거나 열린 파일이 없으면 NULL을 돌려준다. */
+static struct file *get_file(int fd)
+{
+    struct file *file = process_get_file(fd);
+    if (file == NULL || is_dir(file))
+        return NULL;
+    return file;
+}
+
 void exit(int status)
 {
     struct thread *cur = thread_current();
@@ -145,33 +295,25 @@ void halt(void)
 
 bool create(const char *file, unsigned initial_size)
 {
-    lock_acquire(&filesys_lock);
-    check_address(file);
-    bool success = filesys_create(file, initial_size);
-    lock_release(&filesys_lock);
-    return success;
+    check_string(file);
+    return filesys_create(file, initial_size);
 }
 
 bool remove(const char *file)
 {
-    check_address(file);
+    check_string(file);
     return filesys_remove(file);
 }
 
 int open(const char *file_name)
 {
-    check_address(file_name);
-    lock_acquire(&filesys_lock);
+    check_string(file_name);
     struct file *file = filesys_open(file_name);
     if (file == NULL)
-    {
-        lock_release(&filesys_lock);
         return -1;
-    }
     int fd = process_add_file(file);
     if (fd == -1)
         file_close(file);
-    lock_release(&filesys_lock);
     return fd;
 }
 
@@ -246,7 +388,7 @@ int read(int fd, void *buffer, unsigned size)
     //     lock_release(&filesys_lock);
     // }
     // return bytes_read;
-    check_address(buffer);
+    check_buffer(buffer, size, true);
     off_t read_byte;
     uint8_t *read_buffer = buffer;
     if (fd == 0) // stdin
@@ -268,21 +410,19 @@ int read(int fd, void *buffer, unsigned size)
     }
     else
     {
-        struct file *read_file = process_get_file(fd);
+        struct file *read_file = get_file(fd);
         if (read_file == NULL)
         {
             return -1;
         }
-        lock_acquire(&filesys_lock);
         read_byte = file_read(read_file, buffer, size);
-        lock_release(&filesys_lock);
     }
     return read_byte;
 }
 
 int write(int fd, const void *buffer, unsigned size)
 {
-    check_address(buffer);
+    check_buffer(buffer, size, false);
     int bytes_write = 0;
     if (fd == STDOUT_FILENO)
     {
@@ -293,16 +433,243 @@ int write(int fd, const void *buffer, unsigned size)
     {
         if (fd < 2)
             return -1;
-        struct file *file = process_get_file(fd);
+        struct file *file = get_file(fd);
         if (file == NULL)
             return -1;
-        lock_acquire(&filesys_lock);
         bytes_write = file_write(file, buffer, size);
-        lock_release(&filesys_lock);
     }
     return bytes_write;
 }
 
+/* offset 위치부터 읽는다. 파일의 현재 위치는 바뀌지 않으므로
+   여러 스레드가 seek 없이 같은 fd를 읽을 수 있다. */
+int pread(int fd, void *buffer, unsigned size, off_t offset)
+{
+    check_buffer(buffer, size, true);
+    struct file *file = get_file(fd);
+    if (fd < 2 || file == NULL || offset < 0)
+        return -1;
+    return file_read_at(file, buffer, size, offset);
+}
+
+/* offset 위치부터 쓴다. 파일의 현재 위치는 바뀌지 않는다. */
+int pwrite(int fd, const void *buffer, unsigned size, off_t offset)
+{
+    check_buffer(buffer, size, false);
+    struct file *file = get_file(fd);
+    if (fd < 2 || file == NULL || offset < 0)
+        return -1;
+    return file_write_at(file, buffer, size, offset);
+}
+
+/* iov 배열 자체와 각 버퍼 전체를 검사한다. readv처럼 버퍼에 쓸 때는
+   writable을 true로 준다.
+   struct iovec과 struct file_vec은 같은 모양이라 복사하지 않고 그대로 쓴다. */
+static bool check_iovec(const struct file_vec *iov, int iovcnt, bool writable)
+{
+    if (iovcnt < 0 || iovcnt > IOV_MAX)
+        return false;
+    check_buffer(iov, iovcnt * sizeof *iov, false);
+    for (int i = 0; i < iovcnt; i++)
+        check_buffer(iov[i].base, iov[i].len, writable);
+    return true;
+}
+
+/* 여러 버퍼로 차례대로 읽는다. 파일이면 한 번의 잠금 안에서 읽고
+   읽은 만큼 위치를 옮긴다. */
+int readv(int fd, const struct file_vec *iov, int iovcnt)
+{
+    if (!check_iovec(iov, iovcnt, true))
+        return -1;
+    if (fd < 2)
+    {
+        int total = 0;
+        for (int i = 0; i < iovcnt; i++)
+        {
+            if (iov[i].len == 0)
+                continue;
+            int n = read(fd, iov[i].base, iov[i].len);
+            if (n < 0)
+                return -1;
+            total += n;
+            if ((size_t)n < iov[i].len)
+                break;
+        }
+        return total;
+    }
+    struct file *file = get_file(fd);
+    if (file == NULL)
+        return -1;
+    off_t bytes_read = file_readv_at(file, iov, iovcnt, file_tell(file));
+    file_seek(file, file_tell(file) + bytes_read);
+    return bytes_read;
+}
+
+/* 여러 버퍼를 차례대로 쓴다. 파일이면 다른 읽기/쓰기와 섞이지 않는다. */
+int writev(int fd, const struct file_vec *iov, int iovcnt)
+{
+    if (!check_iovec(iov, iovcnt, false))
+        return -1;
+    if (fd < 2)
+    {
+        int total = 0;
+        for (int i = 0; i < iovcnt; i++)
+        {
+            if (iov[i].len == 0)
+                continue;
+            int n = write(fd, iov[i].base, iov[i].len);
+            if (n < 0)
+                return -1;
+            total += n;
+        }
+        return total;
+    }
+    struct file *file = get_file(fd);
+    if (file == NULL)
+        return -1;
+    off_t bytes_written = file_writev_at(file, iov, iovcnt, file_tell(file));
+    file_seek(file, file_tell(file) + bytes_written);
+    return bytes_written;
+}
+
+/* in_fd의 현재 위치부터 size 바이트를 out_fd로 복사한다. out_fd는 파일이나
+   STDOUT_FILENO다. 데이터는 버퍼 캐시와 커널 페이지 하나 사이만 오가고
+   사용자 메모리는 건드리지 않는다. 두 파일의 위치 모두 복사한 만큼 옮긴다. */
+int sendfile(int out_fd, int in_fd, unsigned size)
+{
+    struct file *in = get_file(in_fd);
+    struct file *out = NULL;
+    if (in_fd < 2 || in == NULL)
+        return -1;
+    if (out_fd != STDOUT_FILENO)
+    {
+        out = get_file(out_fd);
+        if (out_fd < 2 || out == NULL)
+            return -1;
+    }
+
+    uint8_t *page = palloc_get_page(0);
+    if (page == NULL)
+        return -1;
+    int total = 0;
+    while (size > 0)
+    {
+        off_t chunk = size < PGSIZE ? size : PGSIZE;
+        off_t n = file_read(in, page, chunk);
+        if (n <= 0)
+            break;
+        if (out == NULL)
+            putbuf((char *)page, n);
+        else
+        {
+            off_t written = file_write(out, page, n);
+            if (written < n)
+            {
+                /* 쓰지 못한 만큼 읽기 위치를 되돌린다. */
+                file_seek(in, file_tell(in) - (n - written));
+                total += written;
+                break;
+            }
+        }
+        total += n;
+        size -= n;
+        if (n < chunk)
+            break;
+    }
+    palloc_free_page(page);
+    return total;
+}
+
+/* fd에 쓴 데이터와 그 데이터를 찾는 데 필요한 메타데이터를 디스크에 내린다.
+   진행 중인 저널 트랜잭션도 함께 커밋하므로 방금 만든 파일의 이름도 남는다. */
+int fsync(int fd)
+{
+    struct file *file = process_get_file(fd);
+    if (fd < 2 || file == NULL)
+        return -1;
+    file_sync(file, false);
+    return 0;
+}
+
+/* fsync와 같지만 파일의 메타데이터가 바뀌지 않았으면 저널을 커밋하지 않는다. */
+int fdatasync(int fd)
+{
+    struct file *file = process_get_file(fd);
+    if (fd < 2 || file == NULL)
+        return -1;
+    file_sync(file, true);
+    return 0;
+}
+
+/* 모든 파일의 데이터와 메타데이터를 디스크에 내린다. */
+void sync(void)
+{
+    filesys_sync();
+}
+
+/* offset부터 len 바이트에 디스크 공간을 데이터를 쓰지 않고 미리 잡는다.
+   가능한 한 연속된 섹터로 한 번에 잡고, 쓰기 전까지는 0으로 읽힌다.
+   범위가 파일 끝을 넘으면 파일이 커진다.
+   mode가 FALLOC_FL_PUNCH_HOLE이면 반대로 범위의 공간을 돌려주고 구멍으로 만든다.
+   파일 길이는 바뀌지 않는다. */
+int fallocate(int fd, int mode, off_t offset, off_t len)
+{
+    struct file *file = get_file(fd);
+    // offset + len이 off_t 범위를 넘는지는 더하기 전에 검사해야 한다.
+    if (fd < 2 || file == NULL || offset < 0 || len <= 0 || len > INT32_MAX - offset)
+        return -1;
+    if (mode == FALLOC_FL_PUNCH_HOLE)
+    {
+        file_punch(file, offset, len);
+        return 0;
+    }
+    if (mode != 0)
+        return -1;
+    return file_allocate(file, offset, len) ? 0 : -1;
+}
+
+/* 디렉터리 fd의 현재 위치부터 항목을 최대 cnt개 읽어 entries에 채우고
+   fd의 위치를 다음 항목으로 옮긴다. seek(fd, 0)으로 처음부터 다시 읽는다.
+   항목은 한 섹터 분량씩 읽어 커널 페이지에 모았다가, 디렉터리 잠금을
+   놓은 뒤에 사용자 메모리로 복사한다. 읽은 항목 수를 돌려주고 끝이면 0,
+   fd가 디렉터리가 아니면 -1이다.
+   struct dirent와 struct dir_record는 같은 모양이다. */
+int getdents(int fd, struct dir_record *entries, int cnt)
+{
+    struct file *file = process_get_file(fd);
+    if (fd < 2 || file == NULL || !is_dir(file) || cnt < 0)
+        return -1;
+    check_buffer(entries, (size_t)cnt * sizeof *entries, true);
+    if (cnt == 0)
+        return 0;
+
+    struct dir_record *page = palloc_get_page(0);
+    struct dir *dir = dir_open(inode_reopen(file_get_inode(file)));
+    if (page == NULL || dir == NULL)
+    {
+        palloc_free_page(page);
+        dir_close(dir);
+        return -1;
+    }
+    dir_seek(dir, file_tell(file));
+    int total = 0;
+    while (total < cnt)
+    {
+        size_t n = PGSIZE / sizeof *page;
+        if ((size_t)(cnt - total) < n)
+            n = cnt - total;
+        n = dir_readdir_many(dir, page, n);
+        if (n == 0)
+            break;
+        memcpy(entries + total, page, n * sizeof *page);
+        total += n;
+    }
+    file_seek(file, dir_tell(dir));
+    dir_close(dir);
+    palloc_free_page(page);
+    return total;
+}
+
 pid_t fork(const char *thread_name)
 {
     return process_fork(thread_name, &thread_current()->parent_if);
@@ -310,7 +677,7 @@ pid_t fork(const char *thread_name)
 
 int exec(const char *file)
 {
-    check_address(file);
+    check_string(file);
     /* process.c 파일의 process_create_initd 함수와 유사하다.
         이 함수에서는 새 스레드를 생성하지 않고 process_exec을 호출한다. */
     /* 커널 메모리 공간에 file의 복사본을 만든다. */
@@ -328,4 +695,53 @@ int exec(const char *file)
 int wait(int pid)
 {
     return process_wait(pid);
-}
\ No newline at end of file
+}
+
+#ifdef VM
+/* fd로 열린 파일을 addr부터 length 바이트만큼 매핑한다.
+   같은 파일의 매핑과 read/write는 페이지 캐시를 공유한다. */
+void *mmap(void *addr, size_t length, int writable, int fd, off_t offset)
+{
+    struct file *file = get_file(fd);
+    if (fd < 2 || file == NULL)
+        return NULL;
+    return do_mmap(addr, length, writable, file, offset);
+}
+
+void munmap(void *addr)
+{
+    do_munmap(addr);
+}
+
+/* 주어진 범위의 접근 패턴 힌트를 기록한다. 성공하면 0, 실패하면 -1. */
+int madvise(void *addr, size_t length, int advice)
+{
+    return vm_madvise(addr, length, advice) ? 0 : -1;
+}
+
+/* 범위의 페이지를 즉시 올리고 eviction 대상에서 제외한다. */
+int mlock(const void *addr, size_t length)
+{
+    return vm_mlock((void *)addr, length, true) ? 0 : -1;
+}
+
+int munlock(const void *addr, size_t length)
+{
+    return vm_mlock((void *)addr, length, false) ? 0 : -1;
+}
+
+/* 현재 프로세스의 메모리 사용량(페이지 단위)을 usage에 채운다. */
+int memstat(struct vm_usage *usage)
+{
+    check_buffer(usage, sizeof *usage, true);
+    vm_get_usage(usage);
+    return 0;
+}
+
+/* 상주 페이지 수를 pages개로 제한한다. 0이면 제한을 없앤다. */
+int memlimit(size_t pages)
+{
+    vm_set_resident_limit(pages);
+    return 0;
+}
+#endif
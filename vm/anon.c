@@ -2,6 +2,13 @@
 
 #include "vm/vm.h"
 #include "devices/disk.h"
+#include <bitmap.h>
+#include <string.h>
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of disk sectors that hold one page. */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -9,6 +16,10 @@ static bool anon_swap_in (struct page *page, void *kva);
 static bool anon_swap_out (struct page *page);
 static void anon_destroy (struct page *page);
 
+/* Swap slots in use, one bit per page-sized slot of swap_disk. */
+static struct bitmap *swap_table;
+static struct lock swap_lock;
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
 	.swap_in = anon_swap_in,
@@ -20,33 +31,101 @@ static const struct page_operations anon_ops = {
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	swap_disk = disk_get (1, 1);
+	lock_init (&swap_lock);
+	swap_table = bitmap_create (swap_disk != NULL
+			? disk_size (swap_disk) / SECTORS_PER_PAGE : 0);
+	if (swap_table == NULL)
+		PANIC ("swap table creation failed");
 }
 
-/* Initialize the file mapping */
+/* Initialize the file mapping.  Pages that start out zeroed, those of
+ * the stack and of the executable's BSS, are allocated with
+ * VM_MARKER_0 in TYPE; other anonymous pages are loaded from the
+ * executable by their initializer once this returns. */
 bool
 anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	/* Set up the handler */
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->swap_slot = SWAP_SLOT_NONE;
+	anon_page->zero_fill = (type & VM_MARKER_0) != 0;
+	memset (kva, 0, PGSIZE);
+	return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Releases the swap slot of ANON_PAGE, which belongs to OWNER, if it
+ * has one. */
+static void
+swap_slot_free (struct anon_page *anon_page, struct thread *owner) {
+	if (anon_page->swap_slot == SWAP_SLOT_NONE)
+		return;
+	lock_acquire (&swap_lock);
+	bitmap_reset (swap_table, anon_page->swap_slot);
+	owner->spt.swapped--;
+	lock_release (&swap_lock);
+	anon_page->swap_slot = SWAP_SLOT_NONE;
+}
+
+/* Swap in the page by read contents from the swap disk.
+ * A page without a swap slot was discarded and comes back zeroed. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+
+	if (anon_page->swap_slot == SWAP_SLOT_NONE) {
+		memset (kva, 0, PGSIZE);
+		return true;
+	}
+
+	for (int i = 0; i < SECTORS_PER_PAGE; i++)
+		disk_read (swap_disk, anon_page->swap_slot * SECTORS_PER_PAGE + i,
+				(uint8_t *) kva + i * DISK_SECTOR_SIZE);
+	swap_slot_free (anon_page, page->frame->owner);
+	return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	lock_acquire (&swap_lock);
+	size_t slot = bitmap_scan_and_flip (swap_table, 0, 1, false);
+	if (slot != BITMAP_ERROR)
+		page->frame->owner->spt.swapped++;
+	lock_release (&swap_lock);
+	if (slot == BITMAP_ERROR)
+		return false;
+
+	for (int i = 0; i < SECTORS_PER_PAGE; i++)
+		disk_write (swap_disk, slot * SECTORS_PER_PAGE + i,
+				(uint8_t *) page->frame->kva + i * DISK_SECTOR_SIZE);
+	anon_page->swap_slot = slot;
+	return true;
 }
 
-/* Destroy the anonymous page. PAGE will be freed by the caller. */
+/* Drops PAGE's contents without writing them anywhere: its frame and
+ * swap slot are released at once and the next access sees a zeroed
+ * page.  Used for MADV_DONTNEED by the process that owns PAGE, which
+ * must have started out zeroed: a page loaded from the executable
+ * would lose its initial contents. */
+void
+anon_discard (struct page *page) {
+	ASSERT (VM_TYPE (page->operations->type) == VM_ANON);
+	ASSERT (page->anon.zero_fill);
+
+	vm_free_frame (page);
+	swap_slot_free (&page->anon, thread_current ());
+}
+
+/* Destroy the anonymous page. PAGE will be freed by the caller.
+ * Pages are only destroyed by the process that owns them. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	vm_free_frame (page);
+	swap_slot_free (anon_page, thread_current ());
 }
@@ -1,6 +1,14 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include <hash.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
@@ -14,45 +22,355 @@ static const struct page_operations file_ops = {
 	.type = VM_FILE,
 };
 
+/* One page of a file's contents, shared by every mapping of that page
+ * and consulted by inode_read_at() and inode_write_at(), so that all of
+ * them see the same bytes.  It lives as long as something references
+ * it; dirty contents are written back whenever a mapping lets go. */
+struct cache_page {
+	struct hash_elem elem;      /* Element in cache_pages. */
+	struct inode *inode;        /* File, reference held by the cache. */
+	off_t ofs;                  /* Page-aligned offset within INODE. */
+	void *kva;                  /* Contents, from the user pool. */
+	int ref_cnt;                /* Resident mappings + in-flight reads. */
+	bool dirty;                 /* Newer than the disk. */
+};
+
+/* Resident file pages, keyed by (inode, offset).  CACHE_LOCK guards
+ * the table and every cache_page.  It is taken after the frame lock
+ * and is held across the disk I/O that fills or writes back a page;
+ * inode_read_at() and inode_write_at() called with it held go straight
+ * to disk. */
+static struct hash cache_pages;
+static struct lock cache_lock;
+
+static uint64_t
+cache_page_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct cache_page *cp = hash_entry (e, struct cache_page, elem);
+	return hash_bytes (&cp->inode, sizeof cp->inode) ^ hash_int (cp->ofs);
+}
+
+static bool
+cache_page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct cache_page *a = hash_entry (a_, struct cache_page, elem);
+	const struct cache_page *b = hash_entry (b_, struct cache_page, elem);
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	return a->ofs < b->ofs;
+}
+
 /* The initializer of file vm */
 void
 vm_file_init (void) {
+	hash_init (&cache_pages, cache_page_hash, cache_page_less, NULL);
+	lock_init (&cache_lock);
+}
+
+/* Returns the cached page of INODE at page-aligned OFS, or NULL. */
+static struct cache_page *
+cache_lookup (struct inode *inode, off_t ofs) {
+	struct cache_page key;
+	struct hash_elem *e;
+
+	ASSERT (lock_held_by_current_thread (&cache_lock));
+	key.inode = inode;
+	key.ofs = ofs;
+	e = hash_find (&cache_pages, &key.elem);
+	return e != NULL ? hash_entry (e, struct cache_page, elem) : NULL;
+}
+
+/* Number of bytes of CP that lie within its file. */
+static off_t
+cache_page_bytes (struct cache_page *cp) {
+	off_t left = inode_length (cp->inode) - cp->ofs;
+	if (left < 0)
+		return 0;
+	return left < PGSIZE ? left : PGSIZE;
+}
+
+/* Writes CP back to its file if it is dirty. */
+static void
+cache_writeback (struct cache_page *cp) {
+	ASSERT (lock_held_by_current_thread (&cache_lock));
+	if (cp->dirty) {
+		inode_write_at (cp->inode, cp->kva, cache_page_bytes (cp), cp->ofs);
+		cp->dirty = false;
+	}
+}
+
+/* Drops a reference to CP.  When the last one goes, CP is written back
+ * and freed, and its memory is returned for the caller to keep or
+ * free.  Otherwise returns NULL. */
+static void *
+cache_put (struct cache_page *cp) {
+	void *kva = NULL;
+
+	ASSERT (lock_held_by_current_thread (&cache_lock));
+	if (--cp->ref_cnt == 0) {
+		cache_writeback (cp);
+		hash_delete (&cache_pages, &cp->elem);
+		inode_close (cp->inode);
+		kva = cp->kva;
+		free (cp);
+	}
+	return kva;
+}
+
+/* Looks up the cached page that holds byte OFFSET of INODE and takes a
+ * reference to it.  Returns NULL if that page is not resident, or if
+ * the caller is the cache itself doing I/O. */
+static struct cache_page *
+cache_get (struct inode *inode, off_t offset) {
+	struct cache_page *cp;
+
+	if (lock_held_by_current_thread (&cache_lock))
+		return NULL;
+	lock_acquire (&cache_lock);
+	cp = cache_lookup (inode, ROUND_DOWN (offset, PGSIZE));
+	if (cp != NULL)
+		cp->ref_cnt++;
+	lock_release (&cache_lock);
+	return cp;
+}
+
+/* Undoes cache_get(). */
+static void
+cache_release (struct cache_page *cp) {
+	lock_acquire (&cache_lock);
+	void *kva = cache_put (cp);
+	lock_release (&cache_lock);
+	if (kva != NULL)
+		palloc_free_page (kva);
+}
+
+/* Reads SIZE bytes at OFFSET of INODE into BUFFER from the page cache.
+ * The range must lie within one page.  Returns false, having done
+ * nothing, if that page is not cached.  BUFFER may be user memory: no
+ * lock is held while copying. */
+bool
+file_cache_read (struct inode *inode, void *buffer, off_t size,
+		off_t offset) {
+	struct cache_page *cp = cache_get (inode, offset);
+	if (cp == NULL)
+		return false;
+
+	memcpy (buffer, (uint8_t *) cp->kva + pg_ofs (offset), size);
+	cache_release (cp);
+	return true;
+}
+
+/* Writes SIZE bytes from BUFFER into the page cache at OFFSET of INODE,
+ * leaving the page dirty.  Same contract as file_cache_read(). */
+bool
+file_cache_write (struct inode *inode, const void *buffer, off_t size,
+		off_t offset) {
+	struct cache_page *cp = cache_get (inode, offset);
+	if (cp == NULL)
+		return false;
+
+	memcpy ((uint8_t *) cp->kva + pg_ofs (offset), buffer, size);
+	cp->dirty = true;
+	cache_release (cp);
+	return true;
 }
 
 /* Initialize the file backed page */
 bool
-file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+file_backed_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva) {
+	/* Fetch the aux first: the page's union is about to be reused. */
+	struct file_page *info = page->uninit.aux;
+
 	/* Set up the handler */
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	*file_page = *info;
+	file_page->cpage = NULL;
+	free (info);
+	return file_backed_swap_in (page, kva);
 }
 
-/* Swap in the page by read contents from the file. */
+/* Swap in the page by read contents from the file.
+ * If another mapping already has the page resident, KVA is given back
+ * and the frame takes over the shared memory instead. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	struct cache_page *cp;
+
+	lock_acquire (&cache_lock);
+	cp = cache_lookup (file_page->inode, file_page->ofs);
+	if (cp != NULL) {
+		cp->ref_cnt++;
+		palloc_free_page (kva);
+		page->frame->kva = cp->kva;
+	} else {
+		cp = malloc (sizeof *cp);
+		if (cp == NULL) {
+			lock_release (&cache_lock);
+			return false;
+		}
+		cp->inode = inode_reopen (file_page->inode);
+		cp->ofs = file_page->ofs;
+		cp->kva = kva;
+		cp->ref_cnt = 1;
+		cp->dirty = false;
+
+		off_t bytes = cache_page_bytes (cp);
+		inode_read_at (cp->inode, kva, bytes, cp->ofs);
+		memset ((uint8_t *) kva + bytes, 0, PGSIZE - bytes);
+		hash_insert (&cache_pages, &cp->elem);
+	}
+	file_page->cpage = cp;
+	lock_release (&cache_lock);
+	return true;
+}
+
+/* Detaches PAGE from its shared contents, folding in its dirty bit
+ * and writing the contents back if they are dirty.  If other
+ * references remain, the frame's kva is cleared so that the memory is
+ * not freed with the frame. */
+static void
+file_page_release (struct page *page) {
+	struct file_page *file_page = &page->file;
+	struct frame *frame = page->frame;
+	struct cache_page *cp = file_page->cpage;
+	uint64_t *pml4 = frame->owner->pml4;
+
+	if (cp == NULL)
+		return;
+
+	lock_acquire (&cache_lock);
+	if (pml4 != NULL && pml4_is_dirty (pml4, page->va)) {
+		pml4_set_dirty (pml4, page->va, false);
+		cp->dirty = true;
+	}
+	cache_writeback (cp);
+	if (cache_put (cp) == NULL)
+		frame->kva = NULL;
+	file_page->cpage = NULL;
+	lock_release (&cache_lock);
 }
 
 /* Swap out the page by writeback contents to the file. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	file_page_release (page);
+	return true;
+}
+
+/* Drops PAGE's frame, writing its contents back first if they are
+ * dirty, so that the next access reads them from the file again.
+ * Used for MADV_DONTNEED by the process that owns PAGE. */
+void
+file_backed_discard (struct page *page) {
+	ASSERT (VM_TYPE (page->operations->type) == VM_FILE);
+	ASSERT (!page->locked);
+
+	if (vm_hold_page (page)) {
+		file_page_release (page);
+		vm_free_frame (page);
+	}
+	page->locked = false;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	if (vm_hold_page (page)) {
+		file_page_release (page);
+		vm_free_frame (page);
+	}
+	inode_close (file_page->inode);
+}
+
+/* Returns the mapping information of PAGE if it is a file page,
+ * whether or not it has been faulted in yet; otherwise NULL. */
+static struct file_page *
+page_file_info (struct page *page) {
+	if (page_get_type (page) != VM_FILE)
+		return NULL;
+	if (VM_TYPE (page->operations->type) == VM_UNINIT)
+		return page->uninit.aux;
+	return &page->file;
+}
+
+/* Adds a not-yet-loaded page at VA to the current process mapping the
+ * same file page as INFO. */
+static bool
+file_backed_alloc (void *va, bool writable, const struct file_page *info) {
+	struct file_page *aux = malloc (sizeof *aux);
+	if (aux == NULL)
+		return false;
+
+	*aux = *info;
+	aux->inode = inode_reopen (info->inode);
+	aux->cpage = NULL;
+	if (!vm_alloc_page_with_initializer (VM_FILE, va, writable, NULL, aux)) {
+		inode_close (aux->inode);
+		free (aux);
+		return false;
+	}
+	return true;
+}
+
+/* Gives the current process SRC's file page at the same address.
+ * Mappings are shared, so the child reaches the same cached contents.
+ * Used by fork(). */
+bool
+file_backed_copy (struct page *src) {
+	return file_backed_alloc (src->va, src->writable, page_file_info (src));
 }
 
 /* Do the mmap */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	size_t page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	struct file_page info;
+	size_t i;
+
+	if (addr == NULL || pg_ofs (addr) != 0 || offset < 0
+			|| pg_ofs (offset) != 0 || length == 0 || file == NULL
+			|| file_length (file) == 0)
+		return NULL;
+	if ((uintptr_t) addr + page_cnt * PGSIZE < (uintptr_t) addr
+			|| !is_user_vaddr ((uint8_t *) addr + page_cnt * PGSIZE - 1))
+		return NULL;
+	for (i = 0; i < page_cnt; i++)
+		if (spt_find_page (spt, (uint8_t *) addr + i * PGSIZE) != NULL)
+			return NULL;
+
+	info.inode = file_get_inode (file);
+	info.map_addr = addr;
+	info.cpage = NULL;
+	for (i = 0; i < page_cnt; i++) {
+		info.ofs = offset + i * PGSIZE;
+		if (!file_backed_alloc ((uint8_t *) addr + i * PGSIZE, writable, &info)) {
+			do_munmap (addr);
+			return NULL;
+		}
+	}
+	return addr;
 }
 
 /* Do the munmap */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *va;
+
+	for (va = addr; ; va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+		struct file_page *info;
+
+		if (page == NULL || (info = page_file_info (page)) == NULL
+				|| info->map_addr != addr)
+			break;
+		spt_remove_page (spt, page);
+	}
 }